@@ -1,11 +1,27 @@
 #include <AnalyzerChannelData.h>
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
 
 #include "JtagAnalyzer.h"
 #include "JtagAnalyzerSettings.h"
 
-JtagAnalyzer::JtagAnalyzer() : mSimulationInitilized( false )
+JtagAnalyzer::JtagAnalyzer()
+    : mMarginThreshold( 0 ),
+      mSamplingDelay( 0 ),
+      mHasLateLines( false ),
+      mHasPendingClock( false ),
+      mHasPrevScan( false ),
+      mPrevScanClockSample( 0 ),
+      mLastProgressSample( 0 ),
+      mProgressReportCount( 0 ),
+      mDecodedIrBitOrder( LSB_First ),
+      mDecodedDrBitOrder( LSB_First ),
+      mDecodedShiftIr( false ),
+      mDecodedShiftDr( false ),
+      mSimulationInitilized( false )
 {
     UseFrameV2();
     SetAnalyzerSettings( &mSettings );
@@ -28,23 +44,91 @@ void JtagAnalyzer::SyncToSample( U64 to_sample )
         mTrst->AdvanceToAbsPosition( to_sample );
 }
 
-void JtagAnalyzer::AdvanceTck( Frame& frm, JtagShiftedData& shifted_data )
+void JtagAnalyzer::CheckMargins( AnalyzerChannelData* line, U64 sample_point, JtagClockSample& clock )
 {
-    if( mTrst != NULL && mTrst->WouldAdvancingToAbsPositionCauseTransition( mTck->GetSampleOfNextEdge() ) )
+    // changes within the threshold before the sample point, up to and including the sample point itself
+    if( sample_point > mMarginThreshold && sample_point - mMarginThreshold > line->GetSampleNumber() )
+        line->AdvanceToAbsPosition( sample_point - mMarginThreshold );
+
+    while( line->WouldAdvancingToAbsPositionCauseTransition( sample_point ) )
+    {
+        line->AdvanceToNextEdge();
+        clock.mSetupMargin = std::min( clock.mSetupMargin, U32( sample_point - line->GetSampleNumber() ) );
+    }
+
+    line->AdvanceToAbsPosition( sample_point );
+
+    // a change within the threshold after the sample point
+    if( line->WouldAdvancingToAbsPositionCauseTransition( sample_point + mMarginThreshold - 1 ) )
+        clock.mHoldMargin = std::min( clock.mHoldMargin, U32( line->GetSampleOfNextEdge() - sample_point ) );
+}
+
+void JtagAnalyzer::SampleDataLines( JtagClockSample& clock, bool after_clock, U64 falling_sample, U64 rising_sample )
+{
+    AnalyzerChannelData* lines[ 3 ] = { mTms, mTdi, mTdo };
+    const SamplingEdge edges[ 3 ] = { mSettings.mTmsSamplingEdge, mSettings.mTdiSamplingEdge, mSettings.mTdoSamplingEdge };
+    U8* states[ 3 ] = { &clock.mTms, &clock.mTdi, &clock.mTdo };
+    U64* sample_numbers[ 3 ] = { &clock.mTmsSampleNumber, &clock.mTdiSampleNumber, &clock.mTdoSampleNumber };
+
+    for( int line_idx = 0; line_idx < 3; ++line_idx )
+    {
+        AnalyzerChannelData* line = lines[ line_idx ];
+        if( line == NULL || ( edges[ line_idx ] != SampleOnRisingEdge ) != after_clock )
+            continue;
+
+        U64 sample_point = ( edges[ line_idx ] == SampleOnFallingEdge && falling_sample != 0 ) ? falling_sample : rising_sample;
+        sample_point = std::max( sample_point + mSamplingDelay, line->GetSampleNumber() );
+
+        if( mMarginThreshold != 0 )
+            CheckMargins( line, sample_point, clock );
+
+        line->AdvanceToAbsPosition( sample_point );
+        *states[ line_idx ] = line->GetBitState();
+        *sample_numbers[ line_idx ] = sample_point;
+    }
+}
+
+void JtagAnalyzer::FinishPendingClock( U64 falling_sample, U64 rising_sample )
+{
+    if( !mHasPendingClock )
+        return;
+
+    SampleDataLines( mPendingClock, true, falling_sample, rising_sample );
+    mClocks.push_back( mPendingClock );
+    mHasPendingClock = false;
+}
+
+// the progress bar is updated at most this often
+const int PROGRESS_INTERVAL_MS = 50;
+
+template <bool HAS_TRST>
+void JtagAnalyzer::AdvanceTck()
+{
+    // we've caught up with the captured data, so show what we have so far; the next edge may only come with more data.
+    // A repeat in progress stays open, the data that follows may go on with it
+    if( !mTck->DoMoreTransitionsExistInCurrentData() && !mClocks.empty() )
+        DecodeClocks();
+
+    if( HAS_TRST && mTrst->WouldAdvancingToAbsPositionCauseTransition( mTck->GetSampleOfNextEdge() ) )
     {
         mTrst->AdvanceToNextEdge();
 
-        // close the frame and add it
-        CloseFrameV2( frm, shifted_data, mTrst->GetSampleNumber() );
+        // the clock before the reset can't wait for its later sampling edges
+        FinishPendingClock( mTrst->GetSampleNumber(), mTrst->GetSampleNumber() );
 
-        // reset the TAP state
-        mTAPCtrl.SetState( TestLogicReset );
+        // the decoder closes the frame and resets the TAP state here
+        JtagResetEvent reset;
+        reset.mClockIndex = mClocks.size();
+        reset.mSampleNumber = mTrst->GetSampleNumber();
+        reset.mEndingSampleNumber = reset.mSampleNumber;
+        reset.mMode = DebugPortJtag;
+        reset.mClockCount = 0;
+        mResets.push_back( reset );
 
-        // prepare the reset frame
-        frm.mStartingSampleInclusive = mTrst->GetSampleNumber() + 1;
-        frm.mType = mTAPCtrl.GetCurrState();
+        // find the rising edge of TRST, the decoder can already handle everything up to here
+        if( !mTrst->DoMoreTransitionsExistInCurrentData() )
+            DecodeClocks();
 
-        // find the rising edge of TRST
         mTrst->AdvanceToNextEdge();
 
         // bring TCK here too
@@ -56,6 +140,90 @@ void JtagAnalyzer::AdvanceTck( Frame& frm, JtagShiftedData& shifted_data )
     }
 }
 
+void JtagAnalyzer::FinishCapture()
+{
+    // the capture ends with the last edge of TCK, or of TRST held in reset
+    U64 ending_sample = mTck->GetSampleNumber();
+    if( mTrst != NULL )
+        ending_sample = std::max( ending_sample, mTrst->GetSampleNumber() );
+
+    // the last clock can't wait for its later sampling edges
+    FinishPendingClock( mTck->GetBitState() == BIT_LOW ? mTck->GetSampleNumber() : 0, mTck->GetSampleNumber() );
+
+    DecodeClocks();
+
+    // the time out of JTAG mode so far
+    JtagResetEvent suspended;
+    if( mSwitchDetector.EndSpan( suspended ) )
+        mDecoder.Reset( suspended );
+
+    // the open frame lasts until the end of the capture
+    mDecoder.CloseOpenFrame( ending_sample );
+    QueueDecodedFrames( mDecoder.GetDecodedFrames() );
+    AddReadyFrames( true );
+
+    AddSummariesV2( ending_sample );
+
+    UpdateProgress( ending_sample, true );
+    mResults->CommitResults();
+    mLastCommitTime = std::chrono::steady_clock::now();
+    JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterCommits, 1 );
+}
+
+void JtagAnalyzer::AddSummariesV2( U64 ending_sample )
+{
+    FrameV2 flash_frame_v2;
+    if( mResults->AddFlashStreamV2( flash_frame_v2 ) )
+        mResults->AddFrameV2( flash_frame_v2, "flash", ending_sample, ending_sample );
+
+    if( mFrameFilter.IsEnabled() )
+    {
+        FrameV2 filter_frame_v2;
+        filter_frame_v2.AddInteger( "DroppedFrames", mFrameFilter.GetDroppedCount() );
+        mResults->AddFrameV2( filter_frame_v2, "filter", ending_sample, ending_sample );
+    }
+
+#ifdef JTAG_INSTRUMENTATION
+    FrameV2 frame_v2;
+    mResults->AddInstrumentationV2( frame_v2 );
+    mResults->AddFrameV2( frame_v2, "instrumentation", ending_sample, ending_sample );
+#endif
+}
+
+void JtagAnalyzer::UpdateProgress( U64 sample_number, bool force )
+{
+    // reporting is throttled to PROGRESS_INTERVAL_MS, or a second of captured samples, whichever comes first
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if( !force && sample_number - mLastProgressSample < GetSampleRate() &&
+        now - mLastProgressTime < std::chrono::milliseconds( PROGRESS_INTERVAL_MS ) )
+        return;
+
+    ReportProgress( sample_number );
+    ++mProgressReportCount;
+
+    mLastProgressSample = sample_number;
+    mLastProgressTime = now;
+}
+
+void JtagAnalyzer::QueueDecodedFrames( std::vector<JtagDecodedFrame>& decoded_frames )
+{
+    for( std::vector<JtagDecodedFrame>::iterator dfi( decoded_frames.begin() ); dfi != decoded_frames.end(); ++dfi )
+        mRepeatDetector.Add( *dfi, mReadyFrames );
+
+    decoded_frames.clear();
+}
+
+void JtagAnalyzer::AddReadyFrames( bool end_of_capture )
+{
+    if( end_of_capture )
+        mRepeatDetector.Flush( mReadyFrames );
+
+    for( std::vector<JtagDecodedFrame>::iterator rfi( mReadyFrames.begin() ); rfi != mReadyFrames.end(); ++rfi )
+        CloseFrameV2( *rfi );
+
+    mReadyFrames.clear();
+}
+
 void JtagAnalyzer::Setup()
 {
     // get the channel data pointers
@@ -75,217 +243,678 @@ void JtagAnalyzer::Setup()
         mTrst = GetAnalyzerChannelData( mSettings.mTrstChannel );
     else
         mTrst = NULL;
+
+    // the setup/hold threshold in samples, rounded up
+    mMarginThreshold = U32( ( U64( mSettings.mMarginThreshold ) * GetSampleRate() + 999999999 ) / 1000000000 );
+
+    // the sampling delay in samples, rounded to the nearest sample
+    mSamplingDelay = U32( ( U64( mSettings.mSamplingDelay ) * GetSampleRate() + 500000000 ) / 1000000000 );
+
+    // a clock waits for the edges after it if some line is sampled there
+    mHasLateLines = mSettings.mTmsSamplingEdge != SampleOnRisingEdge ||
+                    ( mTdi != NULL && mSettings.mTdiSamplingEdge != SampleOnRisingEdge ) ||
+                    ( mTdo != NULL && mSettings.mTdoSamplingEdge != SampleOnRisingEdge );
+
+    // TMSC is always read right at the TCKC edges
+    if( mSettings.mWireProtocol == TwoWireOScan1 )
+    {
+        mHasLateLines = false;
+        mCaptureLoop = mTrst != NULL ? &JtagAnalyzer::CaptureOScan1Clocks<true> : &JtagAnalyzer::CaptureOScan1Clocks<false>;
+        return;
+    }
+
+    const bool plain_sampling = !mHasLateLines && mSamplingDelay == 0 && mMarginThreshold == 0;
+
+    if( mTdi != NULL )
+    {
+        if( mTdo != NULL )
+            mTrst != NULL ? SelectCaptureLoop<true, true, true>( plain_sampling ) : SelectCaptureLoop<true, true, false>( plain_sampling );
+        else
+            mTrst != NULL ? SelectCaptureLoop<true, false, true>( plain_sampling ) : SelectCaptureLoop<true, false, false>( plain_sampling );
+    }
+    else
+    {
+        if( mTdo != NULL )
+            mTrst != NULL ? SelectCaptureLoop<false, true, true>( plain_sampling ) : SelectCaptureLoop<false, true, false>( plain_sampling );
+        else
+            mTrst != NULL ? SelectCaptureLoop<false, false, true>( plain_sampling ) : SelectCaptureLoop<false, false, false>( plain_sampling );
+    }
 }
 
-std::vector<U8> BitsToBytes( std::vector<U8>& shifted_data )
+template <bool HAS_TDI, bool HAS_TDO, bool HAS_TRST>
+void JtagAnalyzer::SelectCaptureLoop( bool plain_sampling )
 {
-    std::vector<U8> byteArray;
-
-    // get the numerical value from the bits
-    std::vector<U8>::const_iterator bsi( shifted_data.begin() );
+    if( plain_sampling )
+        mCaptureLoop = &JtagAnalyzer::CaptureClocks<HAS_TDI, HAS_TDO, HAS_TRST, true>;
+    else
+        mCaptureLoop = &JtagAnalyzer::CaptureClocks<HAS_TDI, HAS_TDO, HAS_TRST, false>;
+}
 
-    U8 val;
-    size_t bits_remaining = shifted_data.size();
+// fills byteArray, reusing its memory from frame to frame
+void BitsToBytes( const JtagBitView& shifted_data, std::vector<U8>& byteArray )
+{
+    const U64 bit_count = shifted_data.GetBitCount();
 
     // make an array of 8 bit values
     // e.g. for 10 bits, byteArray[0] would contain the first 2 bits
     // and byteArray[1] would contain the next 8 bits.
-    for( ; bsi != shifted_data.end(); )
-    {
-        for( val = 0; bsi != shifted_data.end(); )
-        {
-            val = ( val << 1 ) | ( *bsi == BIT_HIGH ? 1 : 0 );
+    byteArray.resize( size_t( ( bit_count + 7 ) / 8 ) );
+    if( bit_count == 0 )
+        return;
 
-            --bits_remaining;
-            ++bsi;
+    const U64 first_chunk_bits = ( bit_count % 8 ) == 0 ? 8 : bit_count % 8;
+    byteArray[ 0 ] = U8( shifted_data.GetValue( 0, first_chunk_bits ) );
 
-            if( ( bits_remaining % 8 ) == 0 )
-            {
-                // We've reached a byte boundary
-                break;
-            }
-        }
+    // the rest of the bytes are read 8 at a time, each word already in display order
+    size_t byte_idx = 1;
+    for( U64 bit_idx = first_chunk_bits; bit_idx < bit_count; )
+    {
+        const U64 chunk_bits = std::min( bit_count - bit_idx, U64( 64 ) );
+        const U64 value = shifted_data.GetValue( bit_idx, chunk_bits );
 
-        byteArray.emplace_back( val );
-    }
+        for( U64 shift = chunk_bits; shift > 0; shift -= 8 )
+            byteArray[ byte_idx++ ] = U8( value >> ( shift - 8 ) );
 
-    return byteArray;
+        bit_idx += chunk_bits;
+    }
 }
 
-void JtagAnalyzer::CloseFrameV2( Frame& frm, JtagShiftedData& shifted_data, U64 ending_sample_number )
+void JtagAnalyzer::CloseFrameV2( JtagDecodedFrame& decoded_frame )
 {
-    JtagShiftedData corrected_shifted_data;
+    if( decoded_frame.mFrame.mType == ShiftIR )
+        mDecodedShiftIr = true;
+    else if( decoded_frame.mFrame.mType == ShiftDR )
+        mDecodedShiftDr = true;
+
+    // the payloads of frames that don't match the store filter aren't kept at all, but the instruction and the scans
+    // they make up are still followed
+    if( !mFrameFilter.Matches( decoded_frame ) )
+    {
+        mResults->IndexFrame( JTAG_FRAME_NOT_STORED, decoded_frame.mFrame, decoded_frame.mShiftedData );
+        return;
+    }
+
+    CloseFrame( decoded_frame );
+
+    const JtagShiftedData& shifted_data = decoded_frame.mShiftedData;
+    const Frame& frm = decoded_frame.mFrame;
 
-    CloseFrame( frm, shifted_data, ending_sample_number, &corrected_shifted_data );
+    if( frm.mType == JTAG_SUSPENDED_FRAME )
+    {
+        FrameV2 frame_v2;
+        frame_v2.AddString( "Mode", JtagAnalyzerResults::GetDebugPortModeName( JtagDebugPortMode( frm.mData1 ) ) );
+        frame_v2.AddInteger( "Clocks", frm.mData2 );
+
+        // scan gaps aren't measured across it
+        mHasPrevScan = false;
+
+        mResults->AddFrameV2( frame_v2, "suspended", frm.mStartingSampleInclusive, frm.mEndingSampleInclusive );
+        return;
+    }
+
+    if( frm.mType == JTAG_REPEATED_SCANS_FRAME )
+    {
+        FrameV2 frame_v2;
+        frame_v2.AddInteger( "Count", frm.mData1 );
+        frame_v2.AddInteger( "Scans", frm.mData2 );
+        AddTimingV2( frame_v2, decoded_frame.mTiming );
+
+        // the next gap is measured from the last repeat
+        if( decoded_frame.mTiming.mClockCount != 0 )
+        {
+            mHasPrevScan = true;
+            mPrevScanClockSample = decoded_frame.mTiming.mLastClockSample;
+        }
+
+        mResults->AddFrameV2( frame_v2, "repeat", frm.mStartingSampleInclusive, frm.mEndingSampleInclusive );
+        return;
+    }
+
+    const bool lsb_first = mSettings.IsShiftedLsbFirst( JtagTAPState( frm.mType ) );
 
     FrameV2 frame_v2;
 
     size_t max_bit_count = 0;
 
-    if( corrected_shifted_data.mTdiBits.size() > 0 )
+    if( shifted_data.mTdiBits.GetBitCount() > 0 )
     {
-        std::vector<U8> data = BitsToBytes( corrected_shifted_data.mTdiBits );
+        BitsToBytes( JtagBitView( shifted_data.mTdiBits, lsb_first ), mByteArray );
 
-        frame_v2.AddByteArray( "TDI", &data[ 0 ], data.size() );
+        frame_v2.AddByteArray( "TDI", &mByteArray[ 0 ], mByteArray.size() );
 
-        if( max_bit_count < corrected_shifted_data.mTdiBits.size() )
+        if( max_bit_count < shifted_data.mTdiBits.GetBitCount() )
         {
-            max_bit_count = corrected_shifted_data.mTdiBits.size();
+            max_bit_count = shifted_data.mTdiBits.GetBitCount();
         }
     }
 
-    if( corrected_shifted_data.mTdoBits.size() > 0 )
+    if( shifted_data.mTdoBits.GetBitCount() > 0 )
     {
-        std::vector<U8> data = BitsToBytes( corrected_shifted_data.mTdoBits );
+        BitsToBytes( JtagBitView( shifted_data.mTdoBits, lsb_first ), mByteArray );
 
-        frame_v2.AddByteArray( "TDO", &data[ 0 ], data.size() );
+        frame_v2.AddByteArray( "TDO", &mByteArray[ 0 ], mByteArray.size() );
 
-        if( max_bit_count < corrected_shifted_data.mTdoBits.size() )
+        if( max_bit_count < shifted_data.mTdoBits.GetBitCount() )
         {
-            max_bit_count = corrected_shifted_data.mTdoBits.size();
+            max_bit_count = shifted_data.mTdoBits.GetBitCount();
         }
     }
 
     frame_v2.AddInteger( "BitCount", max_bit_count );
 
-    const char* type = JtagAnalyzerResults::GetStateDescShort( mTAPCtrl.GetCurrState() );
+    if( mSettings.mTAPStateResync )
+        frame_v2.AddBoolean( "StateUncertain", ( frm.mFlags & JTAG_FLAG_STATE_UNCERTAIN ) != 0 );
+
+    AddTimingV2( frame_v2, decoded_frame.mTiming );
+
+    if( frm.mType == ShiftDR && mSettings.mBoundaryRegister.IsLoaded() )
+        AddBoundaryScanV2( frame_v2, shifted_data );
+
+    // idle time since the last shifted bit of the previous scan
+    if( ( frm.mType == ShiftIR || frm.mType == ShiftDR ) && decoded_frame.mTiming.mClockCount != 0 )
+    {
+        if( mHasPrevScan )
+        {
+            const U64 gap = decoded_frame.mTiming.mFirstClockSample - mPrevScanClockSample;
+            frame_v2.AddDouble( "ScanGap", double( gap ) / GetSampleRate() );
+            mResults->AddScanGap( gap );
+        }
+
+        mHasPrevScan = true;
+        mPrevScanClockSample = decoded_frame.mTiming.mLastClockSample;
+    }
+
+    const char* type = JtagAnalyzerResults::GetStateDescShort( decoded_frame.mNextState );
 
     mResults->AddFrameV2( frame_v2, type, frm.mStartingSampleInclusive, frm.mEndingSampleInclusive );
 }
 
-void JtagAnalyzer::CloseFrame( Frame& frm, JtagShiftedData& shifted_data, U64 ending_sample_number,
-                               JtagShiftedData* corrected_shifted_data )
+void JtagAnalyzer::AddTimingV2( FrameV2& frame_v2, const JtagTckTiming& timing )
+{
+    const double sample_period = 1.0 / GetSampleRate();
+
+    if( timing.mPeriodCount != 0 )
+    {
+        frame_v2.AddDouble( "TckFrequency", timing.GetFrequency( GetSampleRate() ) );
+        frame_v2.AddDouble( "TckMinPeriod", timing.mMinPeriod * sample_period );
+        frame_v2.AddDouble( "TckMaxPeriod", timing.mMaxPeriod * sample_period );
+
+        if( timing.mDutyPeriodSum != 0 )
+            frame_v2.AddDouble( "TckDutyCycle", timing.GetDutyCycle() );
+    }
+
+    if( timing.mMinSetupMargin != JTAG_NO_MARGIN_VIOLATION )
+        frame_v2.AddDouble( "SetupMargin", timing.mMinSetupMargin * sample_period );
+    if( timing.mMinHoldMargin != JTAG_NO_MARGIN_VIOLATION )
+        frame_v2.AddDouble( "HoldMargin", timing.mMinHoldMargin * sample_period );
+}
+
+void JtagAnalyzer::AddBoundaryScanV2( FrameV2& frame_v2, const JtagShiftedData& shifted_data )
 {
-    // save the TDI/TDO values in the frame
-    if( frm.mType == ShiftIR || frm.mType == ShiftDR )
+    const JtagBoundaryRegister& boundary_register = mSettings.mBoundaryRegister;
+
+    U64 instruction;
+    if( !mResults->GetInstruction( instruction ) )
+        return;
+
+    const char* instruction_name = boundary_register.GetInstructionName( instruction );
+    if( instruction_name == NULL )
+        return;
+
+    frame_v2.AddString( "BoundaryInstruction", instruction_name );
+
+    // the pins on TDO are the ones captured, the ones on TDI are to be driven or preloaded
+    if( shifted_data.mTdoBits.GetBitCount() == boundary_register.GetLength() )
+    {
+        mPinChanges.clear();
+        const U64 changed_count = mCapturedPins.Diff( boundary_register, shifted_data.mTdoBits, mPinChanges );
+        frame_v2.AddString( "CapturedPins", mPinChanges.c_str() );
+        frame_v2.AddInteger( "CapturedPinChanges", changed_count );
+    }
+
+    if( shifted_data.mTdiBits.GetBitCount() == boundary_register.GetLength() )
     {
-        // mind the bit order
-        if( ( frm.mType == ShiftIR && mSettings.mInstructRegBitOrder == LSB_First ) ||
-            ( frm.mType == ShiftDR && mSettings.mDataRegBitOrder == LSB_First ) )
+        mPinChanges.clear();
+        const U64 changed_count = mDrivenPins.Diff( boundary_register, shifted_data.mTdiBits, mPinChanges );
+        frame_v2.AddString( "DrivenPins", mPinChanges.c_str() );
+        frame_v2.AddInteger( "DrivenPinChanges", changed_count );
+    }
+}
+
+void JtagAnalyzer::CloseFrame( JtagDecodedFrame& decoded_frame )
+{
+    // save the TDI/TDO values in the results
+    if( decoded_frame.mFrame.mType == ShiftIR || decoded_frame.mFrame.mType == ShiftDR )
+        mResults->AddShiftedData( decoded_frame.mFrame, decoded_frame.mShiftedData );
+
+    const U64 frame_index = mResults->AddFrame( decoded_frame.mFrame );
+    JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterFramesClosed, 1 );
+    mResults->IndexFrame( frame_index, decoded_frame.mFrame, decoded_frame.mShiftedData );
+}
+
+void JtagAnalyzer::AddClockMarkers()
+{
+    // in OScan1 the nTDI and TDO bits are read from TMSC, on the TCKC rising edges of their own bits;
+    // the markers show the level on TMSC, which is inverted for nTDI
+    const bool oscan1 = mSettings.mWireProtocol == TwoWireOScan1;
+    Channel& tdi_channel = oscan1 ? mSettings.mTmsChannel : mSettings.mTdiChannel;
+    Channel& tdo_channel = oscan1 ? mSettings.mTmsChannel : mSettings.mTdoChannel;
+    const U8 tdi_line_high = oscan1 ? BIT_LOW : BIT_HIGH;
+
+    for( std::vector<JtagClockSample>::const_iterator ci( mClocks.begin() ); ci != mClocks.end(); ++ci )
+    {
+        // mark the rising edge of TCK
+        mResults->AddMarker( ci->mSampleNumber, AnalyzerResults::UpArrow, mSettings.mTckChannel );
+        JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterMarkers, 1 );
+
+        // TDI, TMS and TDO markers where the lines were read, in the order of the OScan1 bits
+        const bool shifted = ( ci->mFlags & JTAG_CLOCK_SHIFTED ) != 0;
+        if( shifted && mSettings.HasTdi() )
         {
-            std::reverse( shifted_data.mTdiBits.begin(), shifted_data.mTdiBits.end() );
-            std::reverse( shifted_data.mTdoBits.begin(), shifted_data.mTdoBits.end() );
+            mResults->AddMarker( ci->mTdiSampleNumber, ( ci->mTdi == tdi_line_high ? AnalyzerResults::One : AnalyzerResults::Zero ),
+                                 tdi_channel );
+            JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterMarkers, 1 );
         }
 
-        mResults->AddShiftedData( shifted_data );
+        // TAP state changes
+        if( ci->mFlags & JTAG_CLOCK_STATE_CHANGED )
+        {
+            mResults->AddMarker( ci->mTmsSampleNumber, AnalyzerResults::Dot, mSettings.mTmsChannel );
+            JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterMarkers, 1 );
+        }
 
-        if( corrected_shifted_data != NULL )
+        if( shifted && mSettings.HasTdo() )
         {
-            corrected_shifted_data->mTdiBits = shifted_data.mTdiBits;
-            corrected_shifted_data->mTdoBits = shifted_data.mTdoBits;
+            mResults->AddMarker( ci->mTdoSampleNumber, ( ci->mTdo == BIT_HIGH ? AnalyzerResults::One : AnalyzerResults::Zero ),
+                                 tdo_channel );
+            JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterMarkers, 1 );
         }
+    }
+}
+
+// A run of clocks decoded by one JtagTapDecoder
+struct JtagDecodeSegment
+{
+    enum StartMode
+    {
+        Continue,     // picks up where the previous block left off
+        AfterTmsSync, // starts in Test-Logic-Reset, the open frame continues from the previous segment
+        AfterTrst     // starts in Test-Logic-Reset, right after TRST
+    };
+
+    StartMode mStartMode;
+    size_t mClockBegin;
+    size_t mClockEnd;
+    size_t mResetBegin;
+    size_t mResetEnd;
+};
+
+// Clocks are decoded in blocks; every block is split into segments at points where the TAP state is known
+const size_t CLOCKS_PER_BLOCK = 1 << 16;
+const size_t MIN_CLOCKS_PER_SEGMENT = 1 << 12;
+
+// in streaming mode, the clocks so far are also decoded and committed when the last commit is this long ago.
+// The time is only looked at every STREAMING_CHECK_CLOCKS clocks.
+const int STREAMING_COMMIT_INTERVAL_MS = 100;
+const size_t STREAMING_CHECK_CLOCKS = 1 << 10;
+
+// five TMS high clocks take the TAP to Test-Logic-Reset from any state
+const size_t TMS_HIGH_CLOCKS_TO_RESET = 5;
+
+bool JtagAnalyzer::IsBlockReady()
+{
+    const size_t num_clocks = mClocks.size();
+    if( num_clocks >= CLOCKS_PER_BLOCK )
+        return true;
+
+    return mSettings.mStreamingMode && num_clocks % STREAMING_CHECK_CLOCKS == STREAMING_CHECK_CLOCKS - 1 &&
+           std::chrono::steady_clock::now() - mLastCommitTime >= std::chrono::milliseconds( STREAMING_COMMIT_INTERVAL_MS );
+}
+
+void JtagAnalyzer::DecodeClocks()
+{
+    JTAG_TIME_SCOPE( mResults->GetInstrumentation(), JtagCounterDecodeNs );
+
+    JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterTckEdges, mClocks.size() );
+    const U64 last_clock_sample = mClocks.empty() ? 0 : mClocks.back().mSampleNumber;
+
+    // the clocks out of JTAG mode aren't decoded
+    mSwitchDetector.Filter( mClocks, mResets );
+    const size_t num_clocks = mClocks.size();
+
+    size_t num_threads = std::thread::hardware_concurrency();
+    if( num_threads == 0 )
+        num_threads = 1;
+
+    const size_t segment_clocks = std::max( MIN_CLOCKS_PER_SEGMENT, num_clocks / num_threads );
+
+    // find the synchronization points
+    std::vector<JtagDecodeSegment> segments;
+
+    JtagDecodeSegment segment;
+    segment.mStartMode = JtagDecodeSegment::Continue;
+    segment.mClockBegin = 0;
+    segment.mResetBegin = 0;
+
+    size_t tms_high_clocks = 0;
+    size_t reset_idx = 0;
+    for( size_t clock_idx = 1; clock_idx < num_clocks; ++clock_idx )
+    {
+        if( mClocks[ clock_idx - 1 ].mTms == BIT_HIGH )
+            ++tms_high_clocks;
+        else
+            tms_high_clocks = 0;
+
+        while( reset_idx < mResets.size() && mResets[ reset_idx ].mClockIndex < clock_idx )
+            ++reset_idx;
+
+        if( clock_idx - segment.mClockBegin < segment_clocks )
+            continue;
+
+        JtagDecodeSegment::StartMode next_start_mode;
+        if( reset_idx < mResets.size() && mResets[ reset_idx ].mClockIndex == clock_idx )
+            next_start_mode = JtagDecodeSegment::AfterTrst;
+        else if( tms_high_clocks >= TMS_HIGH_CLOCKS_TO_RESET )
+            next_start_mode = JtagDecodeSegment::AfterTmsSync;
+        else
+            continue;
+
+        // the resets on the sync point still belong to this segment
+        while( reset_idx < mResets.size() && mResets[ reset_idx ].mClockIndex == clock_idx )
+            ++reset_idx;
+
+        segment.mClockEnd = clock_idx;
+        segment.mResetEnd = reset_idx;
+        segments.push_back( segment );
+
+        segment.mStartMode = next_start_mode;
+        segment.mClockBegin = clock_idx;
+        segment.mResetBegin = reset_idx;
+    }
+
+    segment.mClockEnd = num_clocks;
+    segment.mResetEnd = mResets.size();
+    segments.push_back( segment );
+
+    // decode the first segment with the ongoing decoder, and the rest with fresh ones on their own threads
+    std::vector<JtagTapDecoder> decoders( segments.size() - 1 );
+    for( size_t seg_idx = 1; seg_idx < segments.size(); ++seg_idx )
+    {
+        JtagTapDecoder& decoder = decoders[ seg_idx - 1 ];
+        decoder.Init( &mSettings );
+
+        if( segments[ seg_idx ].mStartMode == JtagDecodeSegment::AfterTrst )
+            decoder.Start( TestLogicReset, true, mResets[ segments[ seg_idx ].mResetBegin - 1 ].mEndingSampleNumber + 1 );
+        else
+        {
+            decoder.Start( TestLogicReset, true, 0 ); // the real starting sample is filled in below
+            decoder.SetPrevClock( mClocks[ segments[ seg_idx ].mClockBegin - 1 ].mSampleNumber );
+        }
+    }
+
+    {
+        JtagThreadGroup threads;
+        for( size_t seg_idx = 1; seg_idx < segments.size(); ++seg_idx )
+        {
+            const JtagDecodeSegment& seg = segments[ seg_idx ];
+            threads.Add( std::thread( &JtagTapDecoder::Decode, &decoders[ seg_idx - 1 ], std::ref( mClocks ), seg.mClockBegin,
+                                      seg.mClockEnd, mResets.data() + seg.mResetBegin, seg.mResetEnd - seg.mResetBegin ) );
+        }
+
+        const JtagDecodeSegment& seg = segments.front();
+        mDecoder.Decode( mClocks, seg.mClockBegin, seg.mClockEnd, mResets.data() + seg.mResetBegin, seg.mResetEnd - seg.mResetBegin );
+    }
+
+    // a segment that starts on a TMS sync point continues the previous segment's Test-Logic-Reset frame
+    for( size_t seg_idx = 1; seg_idx < segments.size(); ++seg_idx )
+    {
+        if( segments[ seg_idx ].mStartMode != JtagDecodeSegment::AfterTmsSync )
+            continue;
+
+        JtagTapDecoder& prev_decoder = ( seg_idx == 1 ) ? mDecoder : decoders[ seg_idx - 2 ];
+        const Frame& prev_open_frame = prev_decoder.GetOpenFrame();
+
+        JtagTapDecoder& decoder = decoders[ seg_idx - 1 ];
+        Frame& first_frame = decoder.GetDecodedFrames().empty() ? decoder.GetOpenFrame() : decoder.GetDecodedFrames().front().mFrame;
+        first_frame.mStartingSampleInclusive = prev_open_frame.mStartingSampleInclusive;
+        first_frame.mFlags = prev_open_frame.mFlags;
 
-        shifted_data.mTdiBits.clear();
-        shifted_data.mTdoBits.clear();
+        JtagTckTiming& first_timing = decoder.GetDecodedFrames().empty() ? decoder.GetOpenTiming() : decoder.GetDecodedFrames().front().mTiming;
+        first_timing.Merge( prev_decoder.GetOpenTiming() );
+        if( first_timing.HasMarginViolation() )
+            first_frame.mFlags |= JTAG_FLAG_MARGIN_VIOLATION | DISPLAY_AS_WARNING_FLAG;
     }
 
-    frm.mEndingSampleInclusive = ending_sample_number;
-    mResults->AddFrame( frm );
+    // add everything to the results, in order
+    AddClockMarkers();
+
+    for( size_t seg_idx = 0; seg_idx < segments.size(); ++seg_idx )
+    {
+        QueueDecodedFrames( ( seg_idx == 0 ) ? mDecoder.GetDecodedFrames() : decoders[ seg_idx - 1 ].GetDecodedFrames() );
+
+        JtagTimingHistogram& periods = ( seg_idx == 0 ) ? mDecoder.GetPeriodHistogram() : decoders[ seg_idx - 1 ].GetPeriodHistogram();
+        mResults->AddTckPeriods( periods );
+        periods.Clear();
+    }
+
+    AddReadyFrames( false );
+
+    // the last segment's decoder carries on with the next block
+    if( !decoders.empty() )
+        std::swap( mDecoder, decoders.back() );
+
+    // update progress bar
+    if( last_clock_sample != 0 )
+        UpdateProgress( last_clock_sample, false );
+
+    mClocks.clear();
+    mResets.clear();
+
+    mResults->CommitResults();
+    mLastCommitTime = std::chrono::steady_clock::now();
+    JTAG_COUNT( mResults->GetInstrumentation(), JtagCounterCommits, 1 );
 }
 
 void JtagAnalyzer::WorkerThread()
 {
     Setup();
 
+    mDecodedSettings = mSettings.GetDecodeSettings();
+    mDecodedIrBitOrder = mSettings.mInstructRegBitOrder;
+    mDecodedDrBitOrder = mSettings.mDataRegBitOrder;
+    mDecodedShiftIr = false;
+    mDecodedShiftDr = false;
+
+    mDecoder.Init( &mSettings );
+    mOScan1Demux.Init();
+    mSwitchDetector.Init( mSettings.mSuspendOutsideJtag );
+    mRepeatDetector.Init( mSettings.mCollapseRepeatedScans );
+
+    JtagFrameFilterConfig store_filter_config;
+    store_filter_config.Parse( mSettings.mStoreFilter );
+    mFrameFilter.Init( store_filter_config, mSettings.IsShiftedLsbFirst( ShiftIR ), mSettings.IsShiftedLsbFirst( ShiftDR ) );
+
+    mHasPrevScan = false;
+    mPrevScanClockSample = 0;
+
+    mCapturedPins.Clear();
+    mDrivenPins.Clear();
+
+    mHasPendingClock = false;
+
+    mLastProgressSample = 0;
+    mLastProgressTime = std::chrono::steady_clock::now();
+    mLastCommitTime = mLastProgressTime;
+    mProgressReportCount = 0;
+
+    mClocks.clear();
+    mClocks.reserve( CLOCKS_PER_BLOCK );
+    mResets.clear();
+
     // make sure that we enter the loop on TRST high (inactive)
     if( mTrst != NULL && mTrst->GetBitState() == BIT_LOW )
     {
-        // since we started on a active TRST we'll
-        // ignore the initial state from the settings
-        mTAPCtrl.SetState( TestLogicReset );
-
         // advance to the rising edge of TRST
         mTrst->AdvanceToNextEdge();
         SyncToSample( mTrst->GetSampleNumber() );
+
+        // since we started on a active TRST we'll
+        // ignore the initial state from the settings
+        mDecoder.Start( TestLogicReset, true, mTck->GetSampleNumber() );
     }
     else
     {
-        mTAPCtrl.SetState( mSettings.mTAPInitialState );
+        // with resync the initial state from the settings is only a guess until TMS tells us otherwise
+        mDecoder.Start( mSettings.mTAPInitialState, !mSettings.mTAPStateResync, mTck->GetSampleNumber() );
     }
 
-    Frame frm;
-    frm.mStartingSampleInclusive = mTck->GetSampleNumber();
-    frm.mType = mTAPCtrl.GetCurrState();
-    frm.mFlags = 0;
-    frm.mData1 = 0;
-    frm.mData2 = 0;
-
-    JtagShiftedData shifted_data;
+    // the SDK stops the worker thread in its wait for more data once the capture has ended;
+    // what was held back for that data is added on the way out
+    try
+    {
+        ( this->*mCaptureLoop )();
+    }
+    catch( ... )
+    {
+        FinishCapture();
+        throw;
+    }
+}
 
+template <bool HAS_TDI, bool HAS_TDO, bool HAS_TRST, bool PLAIN_SAMPLING>
+void JtagAnalyzer::CaptureClocks()
+{
     for( ;; )
     {
-        // advance TCK to the rising edge
-        AdvanceTck( frm, shifted_data );
-        if( mTck->GetBitState() == BIT_LOW )
-            AdvanceTck( frm, shifted_data );
-
-        // advance all other channels here too
-        SyncToSample( mTck->GetSampleNumber() );
+        if( IsBlockReady() )
+            DecodeClocks();
 
-        // mark the rising edge of TCK
-        mResults->AddMarker( mTck->GetSampleNumber(), AnalyzerResults::UpArrow, mSettings.mTckChannel );
+        // advance TCK to the rising edge, keeping the falling edge before it for the duty cycle
+        U64 falling_sample = 0;
+        AdvanceTck<HAS_TRST>();
+        if( mTck->GetBitState() == BIT_LOW )
+        {
+            falling_sample = mTck->GetSampleNumber();
+            AdvanceTck<HAS_TRST>();
+        }
 
-        // save TDI and TDO states markers and data
-        if( mTAPCtrl.GetCurrState() == ShiftIR || mTAPCtrl.GetCurrState() == ShiftDR )
+        const U64 rising_sample = mTck->GetSampleNumber();
+        if( HAS_TRST )
+            mTrst->AdvanceToAbsPosition( rising_sample );
+
+        // the previous clock's lines that are sampled on these edges
+        if( !PLAIN_SAMPLING )
+            FinishPendingClock( falling_sample, rising_sample );
+
+        // capture TMS, TDI and TDO for the decoder
+        JtagClockSample clock;
+        clock.mSampleNumber = rising_sample;
+        clock.mFallingSampleNumber = falling_sample;
+        clock.mTmsSampleNumber = rising_sample;
+        clock.mTdiSampleNumber = rising_sample;
+        clock.mTdoSampleNumber = rising_sample;
+        clock.mTms = BIT_LOW;
+        clock.mTdi = BIT_LOW;
+        clock.mTdo = BIT_LOW;
+        clock.mFlags = 0;
+        clock.mSetupMargin = JTAG_NO_MARGIN_VIOLATION;
+        clock.mHoldMargin = JTAG_NO_MARGIN_VIOLATION;
+
+        if( PLAIN_SAMPLING )
         {
-            size_t bitCount = 0;
+            mTms->AdvanceToAbsPosition( rising_sample );
+            clock.mTms = mTms->GetBitState();
 
-            if( mTdi != NULL )
+            if( HAS_TDI )
             {
-                mResults->AddMarker( mTdi->GetSampleNumber(),
-                                     ( mTdi->GetBitState() == BIT_HIGH ? AnalyzerResults::One : AnalyzerResults::Zero ),
-                                     mSettings.mTdiChannel );
-                shifted_data.mTdiBits.push_back( mTdi->GetBitState() );
-                bitCount = shifted_data.mTdiBits.size();
+                mTdi->AdvanceToAbsPosition( rising_sample );
+                clock.mTdi = mTdi->GetBitState();
             }
 
-            if( mTdo != NULL )
+            if( HAS_TDO )
             {
-                mResults->AddMarker( mTdo->GetSampleNumber(),
-                                     ( mTdo->GetBitState() == BIT_HIGH ? AnalyzerResults::One : AnalyzerResults::Zero ),
-                                     mSettings.mTdoChannel );
-                shifted_data.mTdoBits.push_back( mTdo->GetBitState() );
-                bitCount = shifted_data.mTdoBits.size();
+                mTdo->AdvanceToAbsPosition( rising_sample );
+                clock.mTdo = mTdo->GetBitState();
             }
 
-            if( ( mSettings.mShiftDRBitsPerDataUnit != 0 ) && ( bitCount >= mSettings.mShiftDRBitsPerDataUnit ) )
-            {
-                CloseFrameV2( frm, shifted_data, mTck->GetSampleNumber() );
-
-                // prepare the next frame
-                frm.mStartingSampleInclusive = mTck->GetSampleNumber() + 1;
-                frm.mType = mTAPCtrl.GetCurrState();
+            mClocks.push_back( clock );
+            continue;
+        }
 
-                shifted_data.mStartSampleIndex = frm.mStartingSampleInclusive;
+        SampleDataLines( clock, false, falling_sample, rising_sample );
 
-                mResults->CommitResults();
-            }
+        if( mHasLateLines )
+        {
+            mPendingClock = clock;
+            mHasPendingClock = true;
         }
-
-        // send TMS state to the TAP state machine - returns true if state machine has changed
-        if( mTAPCtrl.AdvanceState( mTms->GetBitState() ) )
+        else
         {
-            mResults->AddMarker( mTms->GetSampleNumber(), AnalyzerResults::Dot, mSettings.mTmsChannel );
+            mClocks.push_back( clock );
+        }
+    }
+}
+
+template <bool HAS_TRST>
+void JtagAnalyzer::CaptureOScan1Clocks()
+{
+    // the TMSC bit read on the last TCKC rising edge, and the falling edge before it
+    bool has_bit = false;
+    U8 tmsc = BIT_LOW;
+    U64 rising_sample = 0;
+    U64 falling_sample = 0;
+
+    for( ;; )
+    {
+        if( IsBlockReady() )
+            DecodeClocks();
 
-            CloseFrameV2( frm, shifted_data, mTck->GetSampleNumber() );
+        AdvanceTck<HAS_TRST>();
 
-            // prepare the next frame
-            frm.mStartingSampleInclusive = mTck->GetSampleNumber() + 1;
-            frm.mType = mTAPCtrl.GetCurrState();
+        const U64 edge_sample = mTck->GetSampleNumber();
+        if( HAS_TRST )
+            mTrst->AdvanceToAbsPosition( edge_sample );
 
-            shifted_data.mStartSampleIndex = frm.mStartingSampleInclusive;
+        if( mTck->GetBitState() == BIT_HIGH )
+        {
+            mTms->AdvanceToAbsPosition( edge_sample );
+            tmsc = mTms->GetBitState();
+            rising_sample = edge_sample;
+            has_bit = true;
+            continue;
+        }
 
-            mResults->CommitResults();
+        // the bit is only data if TMSC held still while TCKC was high, otherwise it's an escape
+        U32 toggle_count = 0;
+        if( has_bit )
+        {
+            while( mTms->WouldAdvancingToAbsPositionCauseTransition( edge_sample - 1 ) )
+            {
+                mTms->AdvanceToNextEdge();
+                ++toggle_count;
+            }
         }
 
-        // update progress bar
-        ReportProgress( mTck->GetSampleNumber() );
+        if( toggle_count >= 2 )
+            mOScan1Demux.AddEscape( toggle_count, edge_sample, mClocks.size(), mResets );
+        else if( has_bit )
+            mOScan1Demux.AddBit( tmsc, rising_sample, falling_sample, mClocks );
+
+        has_bit = false;
+        falling_sample = edge_sample;
     }
 }
 
 bool JtagAnalyzer::NeedsRerun()
 {
-    return false;
+    // the bit count display and the bit order of the bubbles and the export are applied when the
+    // results are formatted, everything else needs a new decode
+    if( mSettings.GetDecodeSettings() != mDecodedSettings )
+        return true;
+
+    // a new bit order only changes what was decoded if there were shift frames it applies to
+    return ( mSettings.mInstructRegBitOrder != mDecodedIrBitOrder && mDecodedShiftIr ) ||
+           ( mSettings.mDataRegBitOrder != mDecodedDrBitOrder && mDecodedShiftDr );
 }
 
 void JtagAnalyzer::SetupResults()
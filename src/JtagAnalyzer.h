@@ -3,9 +3,17 @@
 
 #include <Analyzer.h>
 
+#include <atomic>
+#include <chrono>
+
 #include "JtagAnalyzerSettings.h"
 #include "JtagAnalyzerResults.h"
+#include "JtagFrameFilter.h"
+#include "JtagOScan1.h"
 #include "JtagSimulationDataGenerator.h"
+#include "JtagRepeatDetector.h"
+#include "JtagSwitchDetector.h"
+#include "JtagTapDecoder.h"
 
 class JtagAnalyzer : public Analyzer2
 {
@@ -21,16 +29,73 @@ class JtagAnalyzer : public Analyzer2
     virtual bool NeedsRerun();
     virtual void SetupResults();
 
+    // ReportProgress calls so far
+    U64 GetProgressReportCount() const
+    {
+        return mProgressReportCount;
+    }
+
   protected: // functions
+    // gets the channels and the sampling parameters, and picks the capture loop for them
     void Setup();
     void SyncToSample( U64 to_sample );
 
+    // Captures the clocks until the end of the data. There is one of these for each channel configuration,
+    // so the per-clock code has no checks for lines that aren't there. With PLAIN_SAMPLING, all lines are
+    // sampled right at the TCK rising edge, without margin checks.
+    template <bool HAS_TDI, bool HAS_TDO, bool HAS_TRST, bool PLAIN_SAMPLING>
+    void CaptureClocks();
+
+    template <bool HAS_TDI, bool HAS_TDO, bool HAS_TRST>
+    void SelectCaptureLoop( bool plain_sampling );
+
+    // the capture loop for cJTAG OScan1, reading TMSC on the TCKC edges
+    template <bool HAS_TRST>
+    void CaptureOScan1Clocks();
+
     // advances to the next TCK edge while taking care of transitions on TRST
-    void AdvanceTck( Frame& frm, JtagShiftedData& shifted_data );
+    template <bool HAS_TRST>
+    void AdvanceTck();
+
+    // finds changes of the data line closer to the sample point than mMarginThreshold, and advances it to the sample point
+    void CheckMargins( AnalyzerChannelData* line, U64 sample_point, JtagClockSample& clock );
+
+    // reads the data lines sampled on the clock's rising edge, or with after_clock the ones sampled on the
+    // falling edge after it or the next rising edge
+    void SampleDataLines( JtagClockSample& clock, bool after_clock, U64 falling_sample, U64 rising_sample );
+
+    // at the end of the capture, decodes everything, closes the open frame and adds the summaries
+    void FinishCapture();
+    void AddSummariesV2( U64 ending_sample );
+
+    void UpdateProgress( U64 sample_number, bool force );
+
+    // true for a full block of clocks, or in streaming mode, once the last commit is long enough ago
+    bool IsBlockReady();
+
+    // passes decoded frames through the repeat detection, and adds the ones that come out of it to the results
+    void QueueDecodedFrames( std::vector<JtagDecodedFrame>& decoded_frames );
+    // at the end of the capture, also the scans held back for a repeat
+    void AddReadyFrames( bool end_of_capture );
+
+    // adds the held back clock once the edges after it are known
+    void FinishPendingClock( U64 falling_sample, U64 rising_sample );
+
+    // decodes the captured clocks, in parallel where sync points allow it, and adds everything to the results
+    // that isn't held back for repeat detection
+    void DecodeClocks();
+    void AddClockMarkers();
+
+    // adds the frame, and handles the tdi/tdo data
+    void CloseFrame( JtagDecodedFrame& decoded_frame );
+    void CloseFrameV2( JtagDecodedFrame& decoded_frame );
+
+    // TCK frequency, period range and duty cycle of the frame's clocks
+    void AddTimingV2( FrameV2& frame_v2, const JtagTckTiming& timing );
 
-    // closes the frame, and handles the tdi/tdo data
-    void CloseFrame( Frame& frm, JtagShiftedData& shifted_data, U64 ending_sample_number, JtagShiftedData* corrected_shifted_data = NULL );
-    void CloseFrameV2( Frame& frm, JtagShiftedData& shifted_data, U64 ending_sample_number );
+    // the pins that changed since the last boundary scan, for Shift-DR frames of a whole boundary
+    // register scan while SAMPLE, PRELOAD or EXTEST is loaded
+    void AddBoundaryScanV2( FrameV2& frame_v2, const JtagShiftedData& shifted_data );
 
   protected: // vars
     JtagAnalyzerSettings mSettings;
@@ -44,7 +109,64 @@ class JtagAnalyzer : public Analyzer2
 
     JtagSimulationDataGenerator mSimulationDataGenerator;
 
-    JtagTAP_Controller mTAPCtrl;
+    // the CaptureClocks instantiation for the settings
+    void ( JtagAnalyzer::*mCaptureLoop )();
+
+    // setup/hold threshold in samples, 0 when not checked
+    U32 mMarginThreshold;
+
+    // samples from the sampling edge to where the data lines are read
+    U32 mSamplingDelay;
+
+    // with lines sampled after the rising edge, the last clock is held back until those are read
+    bool mHasLateLines;
+    bool mHasPendingClock;
+    JtagClockSample mPendingClock;
+
+    // clocks captured since the last decode
+    std::vector<JtagClockSample> mClocks;
+    std::vector<JtagResetEvent> mResets;
+
+    JtagTapDecoder mDecoder;
+
+    // turns TMSC bits into TAP clocks for cJTAG
+    JtagOScan1Demux mOScan1Demux;
+
+    // drops the clocks while an SWJ-DP is in SWD or dormant
+    JtagSwitchDetector mSwitchDetector;
+
+    JtagRepeatDetector mRepeatDetector;
+    std::vector<JtagDecodedFrame> mReadyFrames;
+
+    // the frames that come out of the repeat detection are only stored if they match the store filter
+    JtagFrameFilter mFrameFilter;
+
+    // the last clock of the previous Shift-IR/Shift-DR frame, for the gaps between scans
+    bool mHasPrevScan;
+    U64 mPrevScanClockSample;
+
+    U64 mLastProgressSample;
+    std::chrono::steady_clock::time_point mLastProgressTime;
+    std::chrono::steady_clock::time_point mLastCommitTime;
+    U64 mProgressReportCount;
+
+    // FrameV2 TDI/TDO bytes
+    std::vector<U8> mByteArray;
+
+    // the previous boundary scan on TDO and TDI, and the pins that changed since
+    JtagBoundaryDiff mCapturedPins;
+    JtagBoundaryDiff mDrivenPins;
+    std::string mPinChanges;
+
+    // the settings the current results were decoded with
+    std::string mDecodedSettings;
+
+    // the bit orders of the last decode, and whether it had Shift-IR/Shift-DR frames. Those frames are
+    // the only ones with FrameV2 bytes, search index values and filter matches in the bit order of the time.
+    BitOrder mDecodedIrBitOrder;
+    BitOrder mDecodedDrBitOrder;
+    std::atomic<bool> mDecodedShiftIr;
+    std::atomic<bool> mDecodedShiftDr;
 
     bool mSimulationInitilized;
 };
@@ -1,12 +1,14 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <map>
 
 #include <AnalyzerHelpers.h>
 
 #include "JtagAnalyzerResults.h"
 #include "JtagAnalyzer.h"
 #include "JtagAnalyzerSettings.h"
+#include "JtagRepeatDetector.h"
 
 const char* TAPStateDescLong[] = { "Test-Logic-Reset", "Run-Test/Idle",
 
@@ -20,9 +22,28 @@ const char* TAPStateDescShort[] = { "TstLogRst", "RunTstIdl",
 
                                     "SelIRScn",  "CapIR",     "ShIR", "Ex1IR", "PsIR", "Ex2IR", "UpdIR" };
 
+// number of bubble/tabular string sets kept by the string cache
+const size_t STRING_CACHE_ENTRIES = 4096;
+
+// TDI/TDO of frames whose payloads were dropped in streaming mode
+const char* EVICTED_PAYLOAD_STRING = "(evicted)";
+
 JtagAnalyzerResults::JtagAnalyzerResults( JtagAnalyzer* analyzer, JtagAnalyzerSettings* settings )
-    : mSettings( settings ), mAnalyzer( analyzer )
+    : mSettings( settings ),
+      mAnalyzer( analyzer ),
+      mStringCache( STRING_CACHE_ENTRIES ),
+      mLoadedInstruction( NO_INSTRUCTION ),
+      mScanEndDropped( false ),
+      mResetDropped( false ),
+      mScanRead( false )
 {
+    mPayloads.SetMemoryLimit( U64( settings->mPayloadMemoryLimit ) << 20 );
+    mPayloads.SetCompression( settings->mCompressPayloads );
+    mPayloads.SetStreaming( settings->mStreamingMode );
+
+    JtagFlashStreamConfig flash_stream_config;
+    flash_stream_config.Parse( settings->mFlashStream );
+    mFlashStream.Init( flash_stream_config, settings->IsShiftedLsbFirst( ShiftDR ) );
 }
 
 JtagAnalyzerResults::~JtagAnalyzerResults()
@@ -31,51 +52,84 @@ JtagAnalyzerResults::~JtagAnalyzerResults()
 
 void JtagAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel, DisplayBase display_base )
 {
+    JTAG_TIME_SCOPE( mInstrumentation, JtagCounterFormatNs );
+
     ClearResultStrings();
     Frame f = GetFrame( frame_index );
 
     if( channel == mSettings->mTmsChannel )
     {
-        // add the TAP state descriptions to the TMS channel
-        AddResultString( GetStateDescLong( ( JtagTAPState )f.mType ) );
-        AddResultString( GetStateDescShort( ( JtagTAPState )f.mType ) );
+        // add the TAP state descriptions to the TMS channel, with a '?' if the state was only a guess
+        const char* uncertain_mark = f.HasFlag( JTAG_FLAG_STATE_UNCERTAIN ) ? "?" : "";
+        if( f.mType == JTAG_REPEATED_SCANS_FRAME )
+        {
+            AddResultString( GetRepeatDesc( f ).c_str() );
+            AddResultString( "x", JtagShiftedData::GetLengthString( f.mData1, false ).c_str() );
+        }
+        else if( f.mType == JTAG_SUSPENDED_FRAME )
+        {
+            AddResultString( GetSuspendedDesc( f ).c_str() );
+            AddResultString( GetDebugPortModeName( JtagDebugPortMode( f.mData1 ) ) );
+        }
+        else
+        {
+            AddResultString( GetStateDescLong( ( JtagTAPState )f.mType ), uncertain_mark );
+            AddResultString( GetStateDescShort( ( JtagTAPState )f.mType ), uncertain_mark );
+        }
     }
     else if( channel == mSettings->mTdiChannel || channel == mSettings->mTdoChannel )
     {
-        // find this frame's TDI/TDO data
-        JtagShiftedData sd;
-        sd.mStartSampleIndex = f.mStartingSampleInclusive;
-        std::set<JtagShiftedData>::iterator sdi( mShiftedData.find( sd ) );
+        std::vector<std::string> result_strings;
 
-        // found?
-        if( sdi != mShiftedData.end() )
-        {
-            std::string tdi_tdo_result_string =
-                ( channel == mSettings->mTdiChannel
-                      ? sdi->GetTDIString( display_base, JtagShiftedData::TdiTdoStringFormat::Ellipsis256 ).c_str()
-                      : sdi->GetTDOString( display_base, JtagShiftedData::TdiTdoStringFormat::Ellipsis256 ).c_str() );
+        mStringCache.Validate( GetPresentationSettings() );
+        const U64 cache_key = JtagResultStringCache::MakeKey(
+            frame_index, channel == mSettings->mTdiChannel ? JtagResultStringCache::TdiBubble : JtagResultStringCache::TdoBubble,
+            display_base );
 
-            if( mSettings->mShowBitCount )
+        if( !mStringCache.Find( cache_key, result_strings ) )
+        {
+            // only shift frames have TDI/TDO data
+            if( f.mType == ShiftIR || f.mType == ShiftDR )
             {
-                std::string bit_count_string =
-                    ( channel == mSettings->mTdiChannel ? sdi->GetTDILengthString() : sdi->GetTDOLengthString() );
-                tdi_tdo_result_string = tdi_tdo_result_string + " " + bit_count_string;
-            }
+                const JtagPayload payload( channel == mSettings->mTdiChannel ? GetTdiPayload( f ) : GetTdoPayload( f ) );
+                const JtagBitView& bits = payload.GetBits();
+                std::string tdi_tdo_result_string;
+
+                if( payload.IsEvicted() )
+                {
+                    tdi_tdo_result_string = EVICTED_PAYLOAD_STRING;
+                }
+                else
+                {
+                    tdi_tdo_result_string =
+                        JtagShiftedData::GetStringFromBitStates( bits, display_base, JtagShiftedData::TdiTdoStringFormat::Ellipsis256 );
+
+                    if( mSettings->mShowBitCount )
+                    {
+                        std::string bit_count_string = JtagShiftedData::GetLengthString( bits.GetBitCount() );
+                        tdi_tdo_result_string = tdi_tdo_result_string + " " + bit_count_string;
+                    }
+                }
 
-            AddResultString( tdi_tdo_result_string.c_str() );
+                result_strings.push_back( tdi_tdo_result_string );
 
-            int max_lengths[ 4 ] = { 5, 10, 15, 25 };
+                // the shorter versions only format the least significant digits that fit
+                size_t max_lengths[ 4 ] = { 5, 10, 15, 25 };
 
-            for( int i = 0; i < 4; ++i )
-            {
-                if( tdi_tdo_result_string.length() > max_lengths[ i ] )
+                for( int i = 0; i < 4 && !payload.IsEvicted(); ++i )
                 {
-                    std::string short_str = tdi_tdo_result_string.substr( 0, max_lengths[ i ] - 3 );
-                    short_str += "...";
-                    AddResultString( short_str.c_str() );
+                    if( tdi_tdo_result_string.length() > max_lengths[ i ] )
+                    {
+                        result_strings.push_back( JtagShiftedData::GetTailString( bits, display_base, max_lengths[ i ] ) );
+                    }
                 }
             }
+
+            mStringCache.Insert( cache_key, result_strings );
         }
+
+        for( size_t i = 0; i < result_strings.size(); ++i )
+            AddResultString( result_strings[ i ].c_str() );
     }
 
     // char number_str[128];
@@ -85,8 +139,49 @@ void JtagAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& channel,
 
 void JtagAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 export_type_user_id )
 {
+    JTAG_TIME_SCOPE( mInstrumentation, JtagCounterFormatNs );
+
     std::ofstream file_stream( file, std::ios::out );
 
+    if( export_type_user_id == ExportTimingHistogram )
+    {
+        GenerateTimingHistogramFile( file_stream );
+        return;
+    }
+
+    if( export_type_user_id == ExportFlashImage )
+    {
+        file_stream.close();
+        std::ofstream image_stream( file, std::ios::out | std::ios::binary );
+        mFlashStream.WriteImage( image_stream );
+        UpdateExportProgressAndCheckForCancel( 1, 1 );
+        return;
+    }
+
+#ifdef JTAG_INSTRUMENTATION
+    if( export_type_user_id == ExportInstrumentation )
+    {
+        GenerateInstrumentationFile( file_stream );
+        return;
+    }
+#endif
+
+    if( export_type_user_id == ExportValueChanges )
+    {
+        GenerateValueChangesFile( file_stream, display_base );
+        return;
+    }
+
+    // the search export only has the frames matching the search setting
+    const bool export_search_results = ( export_type_user_id == ExportSearchResults );
+    std::vector<U64> frame_indices;
+    if( export_search_results )
+    {
+        JtagSearchQuery query;
+        query.Parse( mSettings->mSearchQuery );
+        mSearchIndex.Find( query, frame_indices );
+    }
+
     U64 trigger_sample = mAnalyzer->GetTriggerSample();
     U32 sample_rate = mAnalyzer->GetSampleRate();
 
@@ -96,15 +191,13 @@ void JtagAnalyzerResults::GenerateExportFile( const char* file, DisplayBase disp
         file_stream << "Time [s];TAP state;TDI;TDO" << std::endl;
 
     Frame frm;
-    JtagShiftedData sd;
-    std::set<JtagShiftedData>::iterator sdi;
     char time_str[ 128 ];
     std::string tdi_str, tdo_str, tdi_count_str, tdo_count_str;
-    const U64 num_frames = GetNumFrames();
+    const U64 num_frames = export_search_results ? frame_indices.size() : GetNumFrames();
     for( U64 fcnt = 0; fcnt < num_frames; fcnt++ )
     {
         // get the frame
-        frm = GetFrame( fcnt );
+        frm = GetFrame( export_search_results ? frame_indices[ fcnt ] : fcnt );
 
         // make the time string
         AnalyzerHelpers::GetTimeString( frm.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, sizeof( time_str ) );
@@ -119,30 +212,40 @@ void JtagAnalyzerResults::GenerateExportFile( const char* file, DisplayBase disp
         tdo_count_str.clear();
         if( tap_state == ShiftIR || tap_state == ShiftDR )
         {
-            // find TDI/TDO data
-            sd.mStartSampleIndex = frm.mStartingSampleInclusive;
-            sdi = mShiftedData.find( sd );
+            const JtagPayload tdi_payload( GetTdiPayload( frm ) );
+            const JtagPayload tdo_payload( GetTdoPayload( frm ) );
+            const JtagBitView& tdi_bits = tdi_payload.GetBits();
+            const JtagBitView& tdo_bits = tdo_payload.GetBits();
+
+            tdi_str = tdi_payload.IsEvicted()
+                          ? EVICTED_PAYLOAD_STRING
+                          : JtagShiftedData::GetStringFromBitStates( tdi_bits, display_base, JtagShiftedData::TdiTdoStringFormat::Break64 );
+            tdo_str = tdo_payload.IsEvicted()
+                          ? EVICTED_PAYLOAD_STRING
+                          : JtagShiftedData::GetStringFromBitStates( tdo_bits, display_base, JtagShiftedData::TdiTdoStringFormat::Break64 );
 
-            // found?
-            if( sdi != mShiftedData.end() )
+            if( mSettings->mShowBitCount )
             {
-                tdi_str = sdi->GetTDIString( display_base, JtagShiftedData::TdiTdoStringFormat::Break64 );
-                tdo_str = sdi->GetTDOString( display_base, JtagShiftedData::TdiTdoStringFormat::Break64 );
-
-                if( mSettings->mShowBitCount )
-                {
-                    tdi_count_str = sdi->GetTDILengthString( false );
-                    tdo_count_str = sdi->GetTDOLengthString( false );
-                }
+                tdi_count_str = JtagShiftedData::GetLengthString( tdi_bits.GetBitCount(), false );
+                tdo_count_str = JtagShiftedData::GetLengthString( tdo_bits.GetBitCount(), false );
             }
         }
 
         // output
+        const char* uncertain_mark = frm.HasFlag( JTAG_FLAG_STATE_UNCERTAIN ) ? "?" : "";
+        std::string state_str;
+        if( frm.mType == JTAG_REPEATED_SCANS_FRAME )
+            state_str = GetRepeatDesc( frm );
+        else if( frm.mType == JTAG_SUSPENDED_FRAME )
+            state_str = GetSuspendedDesc( frm );
+        else
+            state_str = GetStateDescLong( tap_state );
+
         if( mSettings->mShowBitCount )
-            file_stream << time_str << ";" << GetStateDescLong( tap_state ) << ";" << tdi_str << ";" << tdo_str << ";" << tdi_count_str
-                        << ";" << tdo_count_str << std::endl;
+            file_stream << time_str << ";" << state_str << uncertain_mark << ";" << tdi_str << ";" << tdo_str << ";" << tdi_count_str << ";"
+                        << tdo_count_str << std::endl;
         else
-            file_stream << time_str << ";" << GetStateDescLong( tap_state ) << ";" << tdi_str << ";" << tdo_str << std::endl;
+            file_stream << time_str << ";" << state_str << uncertain_mark << ";" << tdi_str << ";" << tdo_str << std::endl;
 
         if( UpdateExportProgressAndCheckForCancel( fcnt, num_frames ) )
             return;
@@ -152,8 +255,278 @@ void JtagAnalyzerResults::GenerateExportFile( const char* file, DisplayBase disp
     UpdateExportProgressAndCheckForCancel( num_frames, num_frames );
 }
 
+void JtagAnalyzerResults::GenerateTimingHistogramFile( std::ofstream& file_stream )
+{
+    const double sample_period = 1.0 / mAnalyzer->GetSampleRate();
+
+    file_stream << "Measurement;From [s];To [s];Count" << std::endl;
+
+    std::lock_guard<std::mutex> lock( mTimingMutex );
+
+    const JtagTimingHistogram* histograms[ 2 ] = { &mTckPeriods, &mScanGaps };
+    const char* measurements[ 2 ] = { "TCK period", "Scan gap" };
+
+    for( int histogram_idx = 0; histogram_idx < 2; ++histogram_idx )
+    {
+        const JtagTimingHistogram& histogram = *histograms[ histogram_idx ];
+        for( size_t bucket = 0; bucket < histogram.GetBucketCount(); ++bucket )
+        {
+            if( histogram.GetCount( bucket ) == 0 )
+                continue;
+
+            file_stream << measurements[ histogram_idx ] << ";" << JtagTimingHistogram::GetBucketBegin( bucket ) * sample_period << ";"
+                        << JtagTimingHistogram::GetBucketEnd( bucket ) * sample_period << ";" << histogram.GetCount( bucket ) << std::endl;
+        }
+    }
+
+    UpdateExportProgressAndCheckForCancel( 1, 1 );
+}
+
+// the bits that differ between two reads, a word at a time; bits past the end of the shorter one read as 0
+static bool GetChangedBits( const JtagPackedBits& bits, const JtagPackedBits& last_bits, std::vector<U64>& words, JtagPackedBits& changed_bits )
+{
+    const U64 bit_count = std::max( bits.GetBitCount(), last_bits.GetBitCount() );
+    const U64 word_count = ( bits.GetBitCount() + 63 ) / 64;
+    const U64 last_word_count = ( last_bits.GetBitCount() + 63 ) / 64;
+
+    bool changed = bits.GetBitCount() != last_bits.GetBitCount();
+
+    words.assign( size_t( ( bit_count + 63 ) / 64 ), 0 );
+    for( size_t word_idx = 0; word_idx < words.size(); ++word_idx )
+    {
+        const U64 word = word_idx < word_count ? bits.GetWords()[ word_idx ] : 0;
+        const U64 last_word = word_idx < last_word_count ? last_bits.GetWords()[ word_idx ] : 0;
+
+        words[ word_idx ] = word ^ last_word;
+        changed |= words[ word_idx ] != 0;
+    }
+
+    changed_bits.Clear();
+    if( !words.empty() )
+        changed_bits.AppendWords( &words[ 0 ], 0, bit_count );
+
+    return changed;
+}
+
+// writes the data scans of the value change export whose TDO differs from the last one read with the same instruction
+class JtagValueChangeWriter
+{
+  public:
+    JtagValueChangeWriter( std::ofstream& file_stream, DisplayBase display_base, bool ir_lsb_first, bool dr_lsb_first, U64 trigger_sample,
+                           U32 sample_rate )
+        : mFileStream( file_stream ),
+          mDisplayBase( display_base ),
+          mIrLsbFirst( ir_lsb_first ),
+          mDrLsbFirst( dr_lsb_first ),
+          mTriggerSample( trigger_sample ),
+          mSampleRate( sample_rate ),
+          mScanRead( false ),
+          mScanEvicted( false ),
+          mScanStartingSample( 0 )
+    {
+    }
+
+    void AddShiftDr( const Frame& frame, const JtagPayload& tdo_payload )
+    {
+        if( !mScanRead )
+            mScanStartingSample = frame.mStartingSampleInclusive;
+
+        tdo_payload.GetBits().AppendTo( mScanTdo );
+        mScanEvicted |= tdo_payload.IsEvicted();
+        mScanRead |= mScanTdo.GetBitCount() > 0 || mScanEvicted;
+    }
+
+    // at Update-DR, with the instruction loaded, or NULL if it isn't known; instruction_id tells the registers
+    // apart. Scans with evicted bits are counted, but not compared.
+    void EndScan( U32 instruction_id, const JtagPackedBits* instruction );
+
+    // Test-Logic-Reset drops the open scan
+    void Reset()
+    {
+        mScanTdo.Clear();
+        mScanRead = false;
+        mScanEvicted = false;
+    }
+
+    // reads collapsed into a repeated scans frame; they read the same values again, so they only count
+    void AddRepeatedReads( const std::vector<U32>& instruction_ids, U64 repeat_count )
+    {
+        for( std::vector<U32>::const_iterator ii( instruction_ids.begin() ); ii != instruction_ids.end(); ++ii )
+            mRegisters[ *ii ].mReadCount += repeat_count;
+    }
+
+  protected:
+    struct RegisterReads
+    {
+        RegisterReads() : mReadCount( 0 )
+        {
+        }
+
+        // the last TDO read, and the reads since the last line written for the register
+        JtagPackedBits mLastTdo;
+        U64 mReadCount;
+    };
+
+    std::ofstream& mFileStream;
+    DisplayBase mDisplayBase;
+    bool mIrLsbFirst;
+    bool mDrLsbFirst;
+    U64 mTriggerSample;
+    U32 mSampleRate;
+
+    // the TDO bits of the open data scan, over all its Shift-DR frames
+    JtagPackedBits mScanTdo;
+    bool mScanRead;
+    bool mScanEvicted;
+    U64 mScanStartingSample;
+
+    // by instruction; the scans with an unknown instruction share one entry
+    std::map<U32, RegisterReads> mRegisters;
+
+    std::vector<U64> mChangedWords;
+    JtagPackedBits mChangedBits;
+};
+
+void JtagValueChangeWriter::EndScan( U32 instruction_id, const JtagPackedBits* instruction )
+{
+    if( mScanRead )
+    {
+        RegisterReads& reads = mRegisters[ instruction_id ];
+        ++reads.mReadCount;
+
+        if( !mScanEvicted )
+        {
+            // the first read of a register has nothing to compare with
+            const bool first_read = reads.mLastTdo.GetBitCount() == 0;
+            if( first_read || GetChangedBits( mScanTdo, reads.mLastTdo, mChangedWords, mChangedBits ) )
+            {
+                char time_str[ 128 ];
+                AnalyzerHelpers::GetTimeString( mScanStartingSample, mTriggerSample, mSampleRate, time_str, sizeof( time_str ) );
+
+                std::string ir_str;
+                if( instruction != NULL )
+                    ir_str = JtagShiftedData::GetStringFromBitStates( JtagBitView( *instruction, mIrLsbFirst ), mDisplayBase,
+                                                                      JtagShiftedData::TdiTdoStringFormat::SingleString );
+
+                std::string changed_str;
+                if( !first_read )
+                    changed_str = JtagShiftedData::GetStringFromBitStates( JtagBitView( mChangedBits, mDrLsbFirst ), mDisplayBase,
+                                                                           JtagShiftedData::TdiTdoStringFormat::Break64 );
+
+                mFileStream << time_str << ";" << ir_str << ";"
+                            << JtagShiftedData::GetStringFromBitStates( JtagBitView( mScanTdo, mDrLsbFirst ), mDisplayBase,
+                                                                        JtagShiftedData::TdiTdoStringFormat::Break64 )
+                            << ";" << changed_str << ";" << reads.mReadCount << std::endl;
+
+                reads.mReadCount = 0;
+            }
+
+            reads.mLastTdo.Swap( mScanTdo );
+        }
+    }
+
+    Reset();
+}
+
+void JtagAnalyzerResults::GenerateValueChangesFile( std::ofstream& file_stream, DisplayBase display_base )
+{
+    file_stream << "Time [s];IR;TDO;Changed;Reads" << std::endl;
+
+    JtagValueChangeWriter writer( file_stream, display_base, mSettings->IsShiftedLsbFirst( ShiftIR ), mSettings->IsShiftedLsbFirst( ShiftDR ),
+                                  mAnalyzer->GetTriggerSample(), mAnalyzer->GetSampleRate() );
+
+    // the instructions are followed through the frame contexts, as the store filter may have dropped the IR scans
+    std::vector<JtagPackedBits> instructions;
+    std::vector<FrameContext> frame_contexts;
+    std::vector<RepeatedReads> repeated_reads;
+    {
+        std::lock_guard<std::mutex> lock( mFrameContextMutex );
+        instructions = mInstructions;
+        frame_contexts = mFrameContexts;
+        repeated_reads = mRepeatedReads;
+    }
+
+    std::vector<FrameContext>::const_iterator context( frame_contexts.begin() );
+    std::vector<RepeatedReads>::const_iterator repeat( repeated_reads.begin() );
+    U32 instruction_id = NO_INSTRUCTION;
+
+    const U64 num_frames = GetNumFrames();
+    for( U64 fcnt = 0; fcnt < num_frames; fcnt++ )
+    {
+        if( context != frame_contexts.end() && context->mFrameIndex == fcnt )
+        {
+            if( context->mScanEnded )
+                writer.EndScan( instruction_id, instruction_id != NO_INSTRUCTION ? &instructions[ instruction_id ] : NULL );
+            if( context->mReset )
+                writer.Reset();
+
+            instruction_id = context->mInstruction;
+            ++context;
+        }
+
+        const Frame frm = GetFrame( fcnt );
+
+        switch( frm.mType )
+        {
+        case TestLogicReset:
+            writer.Reset();
+            break;
+        case ShiftDR:
+            writer.AddShiftDr( frm, GetTdoPayload( frm ) );
+            break;
+        case UpdateDR:
+            writer.EndScan( instruction_id, instruction_id != NO_INSTRUCTION ? &instructions[ instruction_id ] : NULL );
+            break;
+        case JTAG_REPEATED_SCANS_FRAME:
+            if( repeat != repeated_reads.end() && repeat->mFrameIndex == fcnt )
+            {
+                writer.AddRepeatedReads( repeat->mInstructions, frm.mData1 );
+                ++repeat;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if( UpdateExportProgressAndCheckForCancel( fcnt, num_frames ) )
+            return;
+    }
+
+    UpdateExportProgressAndCheckForCancel( num_frames, num_frames );
+}
+
+#ifdef JTAG_INSTRUMENTATION
+void JtagAnalyzerResults::GenerateInstrumentationFile( std::ofstream& file_stream )
+{
+    file_stream << "Counter;Value" << std::endl;
+
+    for( int counter = 0; counter < NUM_JTAG_COUNTERS; ++counter )
+        file_stream << JtagInstrumentation::GetName( JtagCounter( counter ) ) << ";" << mInstrumentation.Get( JtagCounter( counter ) ) << std::endl;
+
+    file_stream << "PayloadBytes;" << mPayloads.GetPayloadBytes() << std::endl;
+    file_stream << "StoredBytes;" << mPayloads.GetStoredBytes() << std::endl;
+    file_stream << "EvictedBytes;" << mPayloads.GetEvictedBytes() << std::endl;
+    file_stream << "SpillFailed;" << ( mPayloads.HasSpillFailed() ? 1 : 0 ) << std::endl;
+
+    UpdateExportProgressAndCheckForCancel( 1, 1 );
+}
+
+void JtagAnalyzerResults::AddInstrumentationV2( FrameV2& frame_v2 )
+{
+    for( int counter = 0; counter < NUM_JTAG_COUNTERS; ++counter )
+        frame_v2.AddInteger( JtagInstrumentation::GetName( JtagCounter( counter ) ), mInstrumentation.Get( JtagCounter( counter ) ) );
+
+    frame_v2.AddInteger( "PayloadBytes", mPayloads.GetPayloadBytes() );
+    frame_v2.AddInteger( "StoredBytes", mPayloads.GetStoredBytes() );
+    frame_v2.AddInteger( "EvictedBytes", mPayloads.GetEvictedBytes() );
+    frame_v2.AddBoolean( "SpillFailed", mPayloads.HasSpillFailed() );
+}
+#endif
+
 void JtagAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase display_base )
 {
+    JTAG_TIME_SCOPE( mInstrumentation, JtagCounterFormatNs );
+
     ClearTabularText();
 
     Frame f = GetFrame( frame_index );
@@ -169,49 +542,79 @@ void JtagAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase
     if( mSettings->mTmsChannel == UNDEFINED_CHANNEL )
         tms_used = false;
 
-    if( mSettings->mTdiChannel == UNDEFINED_CHANNEL )
+    if( !mSettings->HasTdi() )
         tdi_used = false;
 
-    if( mSettings->mTdoChannel == UNDEFINED_CHANNEL )
+    if( !mSettings->HasTdo() )
         tdo_used = false;
 
     if( tms_used = true )
     {
         // add the TAP state descriptions to the TMS channel
 
-        result_strings.push_back( GetStateDescLong( ( JtagTAPState )f.mType ) );
+        if( f.mType == JTAG_REPEATED_SCANS_FRAME )
+            result_strings.push_back( GetRepeatDesc( f ) );
+        else if( f.mType == JTAG_SUSPENDED_FRAME )
+            result_strings.push_back( GetSuspendedDesc( f ) );
+        else
+            result_strings.push_back( GetStateDescLong( ( JtagTAPState )f.mType ) );
+        if( f.HasFlag( JTAG_FLAG_STATE_UNCERTAIN ) )
+            result_strings.back() += "?";
+        if( f.HasFlag( JTAG_FLAG_MARGIN_VIOLATION ) )
+            result_strings.back() += " (setup/hold violation)";
         // result_strings.push_back( GetStateDescShort((JtagTAPState) f.mType) );
     }
     if( tdi_used == true || tdo_used == true )
     {
-        // find this frame's TDI/TDO data
-        JtagShiftedData sd;
-        sd.mStartSampleIndex = f.mStartingSampleInclusive;
-        std::set<JtagShiftedData>::iterator sdi( mShiftedData.find( sd ) );
+        std::vector<std::string> tdi_tdo_strings;
 
-        // found?
-        if( sdi != mShiftedData.end() )
+        mStringCache.Validate( GetPresentationSettings() );
+        const U64 cache_key = JtagResultStringCache::MakeKey( frame_index, JtagResultStringCache::TabularText, display_base );
+
+        if( !mStringCache.Find( cache_key, tdi_tdo_strings ) )
         {
-            if( tdi_used == true )
+            // only shift frames have TDI/TDO data
+            if( f.mType == ShiftIR || f.mType == ShiftDR )
             {
-                std::string tdi_str = sdi->GetTDIString( display_base, JtagShiftedData::TdiTdoStringFormat::Ellipsis256 );
-
-                if( mSettings->mShowBitCount )
-                    tdi_str += " " + sdi->GetTDILengthString();
+                if( tdi_used == true )
+                {
+                    const JtagPayload tdi_payload( GetTdiPayload( f ) );
+                    const JtagBitView& tdi_bits = tdi_payload.GetBits();
+                    std::string tdi_str = EVICTED_PAYLOAD_STRING;
+
+                    if( !tdi_payload.IsEvicted() )
+                    {
+                        tdi_str =
+                            JtagShiftedData::GetStringFromBitStates( tdi_bits, display_base, JtagShiftedData::TdiTdoStringFormat::Ellipsis256 );
+                        if( mSettings->mShowBitCount )
+                            tdi_str += " " + JtagShiftedData::GetLengthString( tdi_bits.GetBitCount() );
+                    }
+
+                    tdi_tdo_strings.push_back( tdi_str );
+                }
 
-                result_strings.push_back( tdi_str.c_str() );
+                if( tdo_used == true )
+                {
+                    const JtagPayload tdo_payload( GetTdoPayload( f ) );
+                    const JtagBitView& tdo_bits = tdo_payload.GetBits();
+                    std::string tdo_str = EVICTED_PAYLOAD_STRING;
+
+                    if( !tdo_payload.IsEvicted() )
+                    {
+                        tdo_str =
+                            JtagShiftedData::GetStringFromBitStates( tdo_bits, display_base, JtagShiftedData::TdiTdoStringFormat::Ellipsis256 );
+                        if( mSettings->mShowBitCount )
+                            tdo_str += " " + JtagShiftedData::GetLengthString( tdo_bits.GetBitCount() );
+                    }
+
+                    tdi_tdo_strings.push_back( tdo_str );
+                }
             }
 
-            if( tdo_used == true )
-            {
-                std::string tdo_str = sdi->GetTDOString( display_base, JtagShiftedData::TdiTdoStringFormat::Ellipsis256 );
-
-                if( mSettings->mShowBitCount )
-                    tdo_str += " " + sdi->GetTDOLengthString();
-
-                result_strings.push_back( tdo_str.c_str() );
-            }
+            mStringCache.Insert( cache_key, tdi_tdo_strings );
         }
+
+        result_strings.insert( result_strings.end(), tdi_tdo_strings.begin(), tdi_tdo_strings.end() );
     }
 
     for( int i = 0; i < result_strings.size(); i++ )
@@ -232,9 +635,227 @@ void JtagAnalyzerResults::GenerateTransactionTabularText( U64 transaction_id, Di
     AddResultString( "not supported" );
 }
 
-void JtagAnalyzerResults::AddShiftedData( const JtagShiftedData& shifted_data )
+void JtagAnalyzerResults::AddShiftedData( Frame& frame, const JtagShiftedData& shifted_data )
+{
+    frame.mData1 = mPayloads.Append( shifted_data.mTdiBits );
+    frame.mData2 = mPayloads.Append( shifted_data.mTdoBits );
+}
+
+JtagPayload JtagAnalyzerResults::GetTdiPayload( const Frame& frame )
+{
+    return mPayloads.GetPayload( frame.mData1, mSettings->IsShiftedLsbFirst( JtagTAPState( frame.mType ) ) );
+}
+
+JtagPayload JtagAnalyzerResults::GetTdoPayload( const Frame& frame )
+{
+    return mPayloads.GetPayload( frame.mData2, mSettings->IsShiftedLsbFirst( JtagTAPState( frame.mType ) ) );
+}
+
+void JtagAnalyzerResults::IndexFrame( U64 frame_index, const Frame& frame, const JtagShiftedData& shifted_data )
+{
+    if( frame_index != JTAG_FRAME_NOT_STORED )
+    {
+        mFrameSummaries.AddFrame( frame_index, frame, std::max( shifted_data.mTdiBits.GetBitCount(), shifted_data.mTdoBits.GetBitCount() ) );
+
+        // the export goes by the stored frames, so it's told about what happened in the dropped ones here
+        std::lock_guard<std::mutex> lock( mFrameContextMutex );
+        const U32 context_instruction = mFrameContexts.empty() ? NO_INSTRUCTION : mFrameContexts.back().mInstruction;
+        if( mLoadedInstruction != context_instruction || mScanEndDropped || mResetDropped )
+        {
+            FrameContext context;
+            context.mFrameIndex = frame_index;
+            context.mInstruction = mLoadedInstruction;
+            context.mScanEnded = mScanEndDropped;
+            context.mReset = mResetDropped;
+            mFrameContexts.push_back( context );
+        }
+
+        mScanEndDropped = false;
+        mResetDropped = false;
+    }
+
+    switch( frame.mType )
+    {
+    case TestLogicReset:
+        mSearchIndex.ResetInstruction();
+        mFlashStream.SetInstruction( false, 0 );
+        mLoadedInstruction = NO_INSTRUCTION;
+        mResetDropped |= frame_index == JTAG_FRAME_NOT_STORED;
+        mScanRead = false;
+        break;
+    case ShiftIR:
+        mSearchIndex.AddInstructionBits( frame_index, shifted_data.mTdiBits );
+        break;
+    case UpdateIR:
+    {
+        mSearchIndex.UpdateInstruction( mSettings->IsShiftedLsbFirst( ShiftIR ) );
+        mSearchIndex.EndScan();
+
+        JtagPackedBits instruction_bits;
+        mLoadedInstruction = mSearchIndex.GetInstructionBits( instruction_bits ) ? GetInstructionId( instruction_bits ) : NO_INSTRUCTION;
+        EndRecentScan( false );
+
+        if( mFlashStream.IsEnabled() )
+        {
+            U64 instruction;
+            const bool instruction_known = mSearchIndex.GetInstruction( instruction );
+            mFlashStream.SetInstruction( instruction_known, instruction );
+        }
+        mFlashStream.EndScan( frame );
+        break;
+    }
+    case ShiftDR:
+        mSearchIndex.AddDataScan( frame_index, JtagBitView( shifted_data.mTdoBits, mSettings->IsShiftedLsbFirst( ShiftDR ) ).GetTailValue() );
+        mFlashStream.AddShiftBits( frame, shifted_data.mTdiBits );
+        mScanRead |= shifted_data.mTdoBits.GetBitCount() > 0;
+        break;
+    case UpdateDR:
+        mSearchIndex.EndScan();
+        mFlashStream.EndScan( frame );
+        // after a dropped Test-Logic-Reset, the export has no open scan left to end
+        mScanEndDropped |= frame_index == JTAG_FRAME_NOT_STORED && !mResetDropped;
+        EndRecentScan( mScanRead );
+        mScanRead = false;
+        break;
+    case JTAG_REPEATED_SCANS_FRAME:
+        mSearchIndex.RepeatScans( frame_index, size_t( frame.mData2 ) );
+        mFlashStream.RepeatScans( frame );
+        if( frame_index != JTAG_FRAME_NOT_STORED )
+            AddRepeatedReads( frame_index, size_t( frame.mData2 ) );
+        break;
+    default:
+        break;
+    }
+}
+
+void JtagAnalyzerResults::EndRecentScan( bool read )
+{
+    mRecentScanReads.push_back( std::vector<U32>() );
+    if( read )
+        mRecentScanReads.back().push_back( mLoadedInstruction );
+
+    if( mRecentScanReads.size() > JtagRepeatDetector::MAX_REPEAT_SCANS )
+        mRecentScanReads.pop_front();
+}
+
+void JtagAnalyzerResults::AddRepeatedReads( U64 frame_index, size_t repeat_scans )
+{
+    if( repeat_scans == 0 || repeat_scans > mRecentScanReads.size() )
+        return;
+
+    RepeatedReads repeated_reads;
+    repeated_reads.mFrameIndex = frame_index;
+    for( size_t scan_idx = mRecentScanReads.size() - repeat_scans; scan_idx < mRecentScanReads.size(); ++scan_idx )
+        repeated_reads.mInstructions.insert( repeated_reads.mInstructions.end(), mRecentScanReads[ scan_idx ].begin(),
+                                             mRecentScanReads[ scan_idx ].end() );
+
+    if( repeated_reads.mInstructions.empty() )
+        return;
+
+    std::lock_guard<std::mutex> lock( mFrameContextMutex );
+    mRepeatedReads.push_back( repeated_reads );
+}
+
+U32 JtagAnalyzerResults::GetInstructionId( const JtagPackedBits& instruction_bits )
+{
+    const U64* words = instruction_bits.GetWords();
+    const size_t word_count = size_t( ( instruction_bits.GetBitCount() + 63 ) / 64 );
+
+    std::pair<U64, std::vector<U64> > key( instruction_bits.GetBitCount(), std::vector<U64>( words, words + word_count ) );
+    std::map<std::pair<U64, std::vector<U64> >, U32>::const_iterator ii( mInstructionIds.find( key ) );
+    if( ii != mInstructionIds.end() )
+        return ii->second;
+
+    std::lock_guard<std::mutex> lock( mFrameContextMutex );
+    const U32 instruction_id = U32( mInstructions.size() );
+    mInstructions.push_back( instruction_bits );
+    mInstructionIds.insert( std::make_pair( key, instruction_id ) );
+    return instruction_id;
+}
+
+bool JtagAnalyzerResults::AddFlashStreamV2( FrameV2& frame_v2 )
+{
+    U64 starting_sample, ending_sample;
+    if( !mFlashStream.GetTransferSamples( starting_sample, ending_sample ) )
+        return false;
+
+    const U64 byte_count = mFlashStream.GetByteCount();
+    const double duration = double( ending_sample - starting_sample ) / double( mAnalyzer->GetSampleRate() );
+
+    frame_v2.AddInteger( "Bytes", byte_count );
+    frame_v2.AddInteger( "Scans", mFlashStream.GetScanCount() );
+    frame_v2.AddDouble( "Duration", duration );
+    frame_v2.AddDouble( "Throughput", duration > 0.0 ? double( byte_count ) / duration : 0.0 );
+
+    return true;
+}
+
+void JtagAnalyzerResults::AddTckPeriods( const JtagTimingHistogram& periods )
+{
+    std::lock_guard<std::mutex> lock( mTimingMutex );
+    mTckPeriods.Merge( periods );
+}
+
+void JtagAnalyzerResults::AddScanGap( U64 gap )
+{
+    std::lock_guard<std::mutex> lock( mTimingMutex );
+    mScanGaps.Add( gap );
+}
+
+void JtagAnalyzerResults::FindScans( const JtagSearchQuery& query, std::vector<U64>& frame_indices )
+{
+    mSearchIndex.Find( query, frame_indices );
+}
+
+void JtagAnalyzerResults::FindInstructionScans( U64 instruction, std::vector<U64>& frame_indices )
+{
+    mSearchIndex.FindInstructionScans( instruction, frame_indices );
+}
+
+bool JtagAnalyzerResults::GetInstruction( U64& instruction )
+{
+    return mSearchIndex.GetInstruction( instruction );
+}
+
+void JtagAnalyzerResults::GetSummaries( S64 starting_sample, S64 ending_sample, size_t max_nodes, std::vector<JtagFrameSummary>& summaries )
+{
+    U64 first_frame, last_frame;
+    if( !GetFramesInRange( starting_sample, ending_sample, &first_frame, &last_frame ) )
+    {
+        summaries.clear();
+        return;
+    }
+
+    mFrameSummaries.GetSummaries( first_frame, last_frame, max_nodes, summaries );
+}
+
+U32 JtagAnalyzerResults::GetPresentationSettings() const
+{
+    // the settings that are applied when formatting the strings
+    return ( mSettings->mShowBitCount ? 1 : 0 ) | ( U32( mSettings->mInstructRegBitOrder ) << 1 ) |
+           ( U32( mSettings->mDataRegBitOrder ) << 2 );
+}
+
+std::string JtagAnalyzerResults::GetRepeatDesc( const Frame& frame )
+{
+    char desc[ 128 ];
+    if( frame.mData2 > 1 )
+        sprintf( desc, "Repeated %llu times (%llu scans)", frame.mData1, frame.mData2 );
+    else
+        sprintf( desc, "Repeated %llu times", frame.mData1 );
+    return desc;
+}
+
+std::string JtagAnalyzerResults::GetSuspendedDesc( const Frame& frame )
+{
+    char desc[ 128 ];
+    sprintf( desc, "%s, JTAG suspended (%llu clocks)", GetDebugPortModeName( JtagDebugPortMode( frame.mData1 ) ), frame.mData2 );
+    return desc;
+}
+
+const char* JtagAnalyzerResults::GetDebugPortModeName( JtagDebugPortMode mode )
 {
-    mShiftedData.insert( shifted_data );
+    return mode == DebugPortSwd ? "SWD" : mode == DebugPortDormant ? "Dormant" : "JTAG";
 }
 
 const char* JtagAnalyzerResults::GetStateDescLong( const JtagTAPState mCurrTAPState )
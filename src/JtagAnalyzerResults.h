@@ -3,9 +3,18 @@
 
 #include <AnalyzerResults.h>
 
-#include <set>
+#include <deque>
+#include <map>
+#include <mutex>
 
 #include "JtagTypes.h"
+#include "JtagFlashStream.h"
+#include "JtagFrameSummary.h"
+#include "JtagInstrumentation.h"
+#include "JtagPayloadArena.h"
+#include "JtagResultStringCache.h"
+#include "JtagSearchIndex.h"
+#include "JtagTckTiming.h"
 
 class JtagAnalyzer;
 class JtagAnalyzerSettings;
@@ -23,19 +32,147 @@ class JtagAnalyzerResults : public AnalyzerResults
     virtual void GeneratePacketTabularText( U64 packet_id, DisplayBase display_base );
     virtual void GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base );
 
-    void AddShiftedData( const JtagShiftedData& shifted_data );
+    // stores the TDI/TDO bits of a shift frame, and refers to them from the frame
+    void AddShiftedData( Frame& frame, const JtagShiftedData& shifted_data );
+
+    // follows every decoded frame in order, and adds the ones that were just stored to the search index and the zoom
+    // summaries; frame_index is JTAG_FRAME_NOT_STORED for the frames the store filter dropped
+    void IndexFrame( U64 frame_index, const Frame& frame, const JtagShiftedData& shifted_data );
+
+    // the Shift-DR frames matching the query, and the Shift-IR frames that loaded an instruction
+    void FindScans( const JtagSearchQuery& query, std::vector<U64>& frame_indices );
+    void FindInstructionScans( U64 instruction, std::vector<U64>& frame_indices );
+
+    // the instruction loaded as of the last indexed frame; false if it isn't known
+    bool GetInstruction( U64& instruction );
+
+    // at most about max_nodes summaries of the frames between the samples, for zoomed out views
+    void GetSummaries( S64 starting_sample, S64 ending_sample, size_t max_nodes, std::vector<JtagFrameSummary>& summaries );
+
+    // size, duration and throughput of the flash programming data; false if there was none
+    bool AddFlashStreamV2( FrameV2& frame_v2 );
+
+    // adds to the histograms of the timing export
+    void AddTckPeriods( const JtagTimingHistogram& periods );
+    void AddScanGap( U64 gap );
 
     // returns the TAP state description
     static const char* GetStateDescLong( const JtagTAPState mCurrTAPState );
     static const char* GetStateDescShort( const JtagTAPState mCurrTAPState );
 
+    // the name of a debug port mode out of JTAG
+    static const char* GetDebugPortModeName( JtagDebugPortMode mode );
+
+#ifdef JTAG_INSTRUMENTATION
+    JtagInstrumentation& GetInstrumentation()
+    {
+        return mInstrumentation;
+    }
+
+    // the counters, and the TDI/TDO bytes as they were appended and as they were stored
+    void AddInstrumentationV2( FrameV2& frame_v2 );
+#endif
+
+    // bubble and tabular string cache statistics
+    U64 GetStringCacheHitCount() const
+    {
+        return mStringCache.GetHitCount();
+    }
+
+    U64 GetStringCacheMissCount() const
+    {
+        return mStringCache.GetMissCount();
+    }
+
   protected: // functions
+    U32 GetPresentationSettings() const;
+
+    // the description of a frame standing in for repeated scans
+    static std::string GetRepeatDesc( const Frame& frame );
+
+    // the description of a frame standing in for the time out of JTAG mode
+    static std::string GetSuspendedDesc( const Frame& frame );
+
+    void GenerateTimingHistogramFile( std::ofstream& file_stream );
+
+    // the data scans whose TDO differs from the last one read with the same instruction, and the bits that changed
+    void GenerateValueChangesFile( std::ofstream& file_stream, DisplayBase display_base );
+#ifdef JTAG_INSTRUMENTATION
+    void GenerateInstrumentationFile( std::ofstream& file_stream );
+#endif
+
+    // the TDI/TDO bits of a shift frame in display order
+    JtagPayload GetTdiPayload( const Frame& frame );
+    JtagPayload GetTdoPayload( const Frame& frame );
+
+    // the index of the instruction in mInstructions, added if it's new
+    U32 GetInstructionId( const JtagPackedBits& instruction_bits );
+
+    // at Update-IR and Update-DR, notes whether the scan read a register for the repeated scans frames
+    void EndRecentScan( bool read );
+    void AddRepeatedReads( U64 frame_index, size_t repeat_scans );
+
+  protected: // types
+    static const U32 NO_INSTRUCTION = ~0U;
+
+    // from the stored frame mFrameIndex on, the instruction mInstruction is loaded. With mScanEnded, an Update-DR
+    // before it wasn't stored, so the data scan ended there; with mReset, a Test-Logic-Reset after that wasn't.
+    struct FrameContext
+    {
+        U64 mFrameIndex;
+        U32 mInstruction;
+        bool mScanEnded;
+        bool mReset;
+    };
+
+    // the registers read by the scans a stored repeated scans frame stands in for, by instruction
+    struct RepeatedReads
+    {
+        U64 mFrameIndex;
+        std::vector<U32> mInstructions;
+    };
+
   protected: // vars
     JtagAnalyzerSettings* mSettings;
     JtagAnalyzer* mAnalyzer;
 
-    // TDI/TDO bits
-    std::set<JtagShiftedData> mShiftedData;
+    // TDI/TDO bits of the shift frames; mData1 and mData2 of those frames are the TDI and TDO offsets
+    JtagPayloadArena mPayloads;
+
+    JtagResultStringCache mStringCache;
+
+    JtagSearchIndex mSearchIndex;
+    JtagFrameSummaryPyramid mFrameSummaries;
+
+    // TDI data of the flash programming scans, for the binary export
+    JtagFlashStream mFlashStream;
+
+    // what the value change export can't see in the stored frames when the store filter drops some: every instruction
+    // loaded once, in shift order, and where the loaded one changed or a scan ended between the stored frames
+    std::vector<JtagPackedBits> mInstructions;
+    std::map<std::pair<U64, std::vector<U64> >, U32> mInstructionIds;
+    std::vector<FrameContext> mFrameContexts;
+    std::vector<RepeatedReads> mRepeatedReads;
+    std::mutex mFrameContextMutex;
+
+    // the instruction loaded as of the last frame followed, and whether an Update-DR or a Test-Logic-Reset was dropped
+    // since the last stored frame
+    U32 mLoadedInstruction;
+    bool mScanEndDropped;
+    bool mResetDropped;
+
+    // whether the open data scan shifted TDO bits, and the registers read by the last scans, the newest at the back
+    bool mScanRead;
+    std::deque<std::vector<U32> > mRecentScanReads;
+
+    // TCK periods and the gaps between scans, in samples
+    JtagTimingHistogram mTckPeriods;
+    JtagTimingHistogram mScanGaps;
+    std::mutex mTimingMutex;
+
+#ifdef JTAG_INSTRUMENTATION
+    JtagInstrumentation mInstrumentation;
+#endif
 };
 
 #endif // JTAG_ANALYZER_RESULTS_H
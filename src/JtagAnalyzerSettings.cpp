@@ -2,25 +2,43 @@
 
 #include "JtagAnalyzerSettings.h"
 #include "JtagAnalyzerResults.h"
+#include "JtagFlashStream.h"
+#include "JtagFrameFilter.h"
+#include "JtagSearchIndex.h"
 #include "JtagTypes.h"
 
+// MB of TDI/TDO data kept in memory, unless set otherwise
+const U32 DEFAULT_PAYLOAD_MEMORY_LIMIT = 1024;
+
 JtagAnalyzerSettings::JtagAnalyzerSettings()
     : mTmsChannel( UNDEFINED_CHANNEL ),
       mTckChannel( UNDEFINED_CHANNEL ),
       mTdiChannel( UNDEFINED_CHANNEL ),
       mTdoChannel( UNDEFINED_CHANNEL ),
       mTrstChannel( UNDEFINED_CHANNEL ),
+      mWireProtocol( FourWireJtag ),
+      mSuspendOutsideJtag( false ),
+      mTmsSamplingEdge( SampleOnRisingEdge ),
+      mTdiSamplingEdge( SampleOnRisingEdge ),
+      mTdoSamplingEdge( SampleOnRisingEdge ),
+      mSamplingDelay( 0 ),
       mTAPInitialState( RunTestIdle ),
+      mTAPStateResync( false ),
       mInstructRegBitOrder( LSB_First ),
       mDataRegBitOrder( LSB_First ),
       mShowBitCount( false ),
-      mShiftDRBitsPerDataUnit( 0 )
+      mShiftDRBitsPerDataUnit( 0 ),
+      mCollapseRepeatedScans( false ),
+      mMarginThreshold( 0 ),
+      mPayloadMemoryLimit( DEFAULT_PAYLOAD_MEMORY_LIMIT ),
+      mCompressPayloads( true ),
+      mStreamingMode( false )
 {
     // init the interfaces
-    mTmsChannelInterface.SetTitleAndTooltip( "TMS", "JTAG Test mode select" );
+    mTmsChannelInterface.SetTitleAndTooltip( "TMS", "JTAG Test mode select, or TMSC for cJTAG" );
     mTmsChannelInterface.SetChannel( mTmsChannel );
 
-    mTckChannelInterface.SetTitleAndTooltip( "TCK", "JTAG Test clock" );
+    mTckChannelInterface.SetTitleAndTooltip( "TCK", "JTAG Test clock, or TCKC for cJTAG" );
     mTckChannelInterface.SetChannel( mTckChannel );
 
     mTdiChannelInterface.SetTitleAndTooltip( "TDI", "JTAG Test data input" );
@@ -35,6 +53,43 @@ JtagAnalyzerSettings::JtagAnalyzerSettings()
     mTrstChannelInterface.SetChannel( mTrstChannel );
     mTrstChannelInterface.SetSelectionOfNoneIsAllowed( true );
 
+    mWireProtocolInterface.SetTitleAndTooltip( "Protocol", "How the TAP is wired" );
+    mWireProtocolInterface.AddNumber( FourWireJtag, "4-wire JTAG (IEEE 1149.1)", "TMS, TCK, TDI and TDO" );
+    mWireProtocolInterface.AddNumber( TwoWireOScan1, "2-wire cJTAG OScan1 (IEEE 1149.7)",
+                                      "TMSC on the TMS channel and TCKC on the TCK channel, with nTDI, TMS and TDO sent in turn on TMSC. "
+                                      "The sampling edge, sampling delay and setup/hold settings don't apply." );
+    mWireProtocolInterface.SetNumber( mWireProtocol );
+
+    mSuspendOutsideJtagInterface.SetTitleAndTooltip( "", "Follow the switch sequences of ARM SWJ-DP debug ports on TMS, and show the time "
+                                                         "in SWD or dormant as a single frame instead of decoding it as JTAG." );
+    mSuspendOutsideJtagInterface.SetCheckBoxText( "Suspend decoding in SWD and dormant" );
+    mSuspendOutsideJtagInterface.SetValue( mSuspendOutsideJtag );
+
+    AnalyzerSettingInterfaceNumberList* sampling_edge_interfaces[ 3 ] = { &mTmsSamplingEdgeInterface, &mTdiSamplingEdgeInterface,
+                                                                          &mTdoSamplingEdgeInterface };
+    const char* line_names[ 3 ] = { "TMS", "TDI", "TDO" };
+    for( int line_idx = 0; line_idx < 3; ++line_idx )
+    {
+        const std::string line_name = line_names[ line_idx ];
+        AnalyzerSettingInterfaceNumberList* edge_interface = sampling_edge_interfaces[ line_idx ];
+
+        edge_interface->SetTitleAndTooltip( ( line_name + " sampling edge" ).c_str(),
+                                            ( "The TCK edge " + line_name + " is read on for a clock" ).c_str() );
+        edge_interface->AddNumber( SampleOnRisingEdge, "Rising edge", "The rising edge of the clock" );
+        edge_interface->AddNumber( SampleOnFallingEdge, "Falling edge", "The falling edge after the rising edge of the clock" );
+        edge_interface->AddNumber( SampleOnNextRisingEdge, "Next rising edge", "The rising edge of the next clock" );
+    }
+
+    mTmsSamplingEdgeInterface.SetNumber( mTmsSamplingEdge );
+    mTdiSamplingEdgeInterface.SetNumber( mTdiSamplingEdge );
+    mTdoSamplingEdgeInterface.SetNumber( mTdoSamplingEdge );
+
+    mSamplingDelayInterface.SetTitleAndTooltip( "Sampling delay (ns)",
+                                                "Read TMS, TDI and TDO this long after their sampling edge, e.g. for TDO that lags TCK." );
+    mSamplingDelayInterface.SetInteger( mSamplingDelay );
+    mSamplingDelayInterface.SetMin( 0 );
+    mSamplingDelayInterface.SetMax( 1000000 );
+
     mTAPInitialStateInterface.SetTitleAndTooltip( "TAP initial state", "JTAG TAP controller initial state" );
     int state_cnt;
     for( state_cnt = 0; state_cnt < NUM_TAP_STATES; ++state_cnt )
@@ -43,6 +98,12 @@ JtagAnalyzerSettings::JtagAnalyzerSettings()
 
     mTAPInitialStateInterface.SetNumber( mTAPInitialState );
 
+    mTAPStateResyncInterface.SetTitleAndTooltip(
+        "", "Track all possible TAP states until the TMS history makes the state unambiguous. Frames decoded before that are "
+            "marked as uncertain." );
+    mTAPStateResyncInterface.SetCheckBoxText( "Resynchronize TAP state from TMS" );
+    mTAPStateResyncInterface.SetValue( mTAPStateResync );
+
     mInstructRegBitOrderInterface.SetTitleAndTooltip( "Shift-IR bit order", "Instruction register shift bit order" );
     mInstructRegBitOrderInterface.AddNumber( MSB_First, "Most significant bit first",
                                              "Instruction register shift MOST significant bit first" );
@@ -61,28 +122,117 @@ JtagAnalyzerSettings::JtagAnalyzerSettings()
     mShiftDRDataUnitInterface.SetMin( 0 );
     mShiftDRDataUnitInterface.SetMax( 65536 );
 
+    mCollapseRepeatedScansInterface.SetTitleAndTooltip(
+        "", "Show scans that repeat the scans before them, like status polling, as a single frame with the repeat count." );
+    mCollapseRepeatedScansInterface.SetCheckBoxText( "Collapse repeated scans" );
+    mCollapseRepeatedScansInterface.SetValue( mCollapseRepeatedScans );
+
+    mMarginThresholdInterface.SetTitleAndTooltip(
+        "Setup/hold threshold (ns)", "Flag frames where TMS, TDI or TDO change closer than this to a TCK rising edge. 0 to not check." );
+    mMarginThresholdInterface.SetInteger( mMarginThreshold );
+    mMarginThresholdInterface.SetMin( 0 );
+    mMarginThresholdInterface.SetMax( 1000000 );
+
     mShowBitCountInterface.SetTitleAndTooltip( "", "Used to count bits sent during Shift state" );
     mShowBitCountInterface.SetCheckBoxText( "Show TDI/TDO bit counts" );
     mShowBitCountInterface.SetValue( mShowBitCount );
 
+    mSearchQueryInterface.SetTitleAndTooltip( "Search export", "Shift-DR scans to export, as IR[:TDO[/MASK]], e.g. 0x0E:0x1234/0xFFFF. "
+                                                               "Use * as IR to match any instruction." );
+    mSearchQueryInterface.SetText( mSearchQuery.c_str() );
+
+    mFlashStreamInterface.SetTitleAndTooltip( "Flash stream", "DR scans with flash programming data for the binary export, as "
+                                                              "IR[:FIRST_BIT[:BIT_COUNT]] of the TDI data field, e.g. 0x0C:1:32. "
+                                                              "Leave empty to not collect it." );
+    mFlashStreamInterface.SetText( mFlashStream.c_str() );
+
+    mStoreFilterInterface.SetTitleAndTooltip( "Store filter", "Only store the frames matching all of these, separated by ';': "
+                                                              "states=STATE,... ir=IR,... tdi=VALUE[/MASK],... tdo=VALUE[/MASK],... "
+                                                              "e.g. ir=0x0E; tdo=0x1234/0xFFFF. The others are only counted. "
+                                                              "Leave empty to store everything." );
+    mStoreFilterInterface.SetText( mStoreFilter.c_str() );
+
+    mBoundaryScanFileInterface.SetTitleAndTooltip( "Boundary-scan BSDL file",
+                                                   "Show the pins that changed in SAMPLE, PRELOAD and EXTEST scans, "
+                                                   "using the boundary register described in this BSDL file. Leave empty to not decode pins." );
+    mBoundaryScanFileInterface.SetTextType( AnalyzerSettingInterfaceText::FilePath );
+    mBoundaryScanFileInterface.SetText( mBoundaryScanFile.c_str() );
+
+    mPayloadMemoryLimitInterface.SetTitleAndTooltip(
+        "TDI/TDO memory limit (MB)",
+        "TDI/TDO data beyond this is kept in a temporary file and read back when needed, or dropped with streaming. "
+        "0 for no limit, which streaming doesn't allow." );
+    mPayloadMemoryLimitInterface.SetInteger( mPayloadMemoryLimit );
+    mPayloadMemoryLimitInterface.SetMin( 0 );
+    mPayloadMemoryLimitInterface.SetMax( 65536 );
+
+    mCompressPayloadsInterface.SetTitleAndTooltip(
+        "", "Run-length encode constant and repetitive TDI/TDO data, and store repeated values only once." );
+    mCompressPayloadsInterface.SetCheckBoxText( "Compress TDI/TDO data" );
+    mCompressPayloadsInterface.SetValue( mCompressPayloads );
+
+    mStreamingModeInterface.SetTitleAndTooltip( "", "For long live captures: drop the oldest TDI/TDO data once the memory limit is reached, "
+                                                    "instead of keeping it in a temporary file, and show results at least every 100 ms. "
+                                                    "Frames whose data was dropped show it as evicted. Needs a memory limit above 0." );
+    mStreamingModeInterface.SetCheckBoxText( "Streaming: keep only the most recent TDI/TDO data" );
+    mStreamingModeInterface.SetValue( mStreamingMode );
+
     // add the interfaces
     AddInterface( &mTmsChannelInterface );
     AddInterface( &mTckChannelInterface );
     AddInterface( &mTdiChannelInterface );
     AddInterface( &mTdoChannelInterface );
     AddInterface( &mTrstChannelInterface );
+    AddInterface( &mWireProtocolInterface );
+    AddInterface( &mSuspendOutsideJtagInterface );
+
+    AddInterface( &mTmsSamplingEdgeInterface );
+    AddInterface( &mTdiSamplingEdgeInterface );
+    AddInterface( &mTdoSamplingEdgeInterface );
+    AddInterface( &mSamplingDelayInterface );
 
     AddInterface( &mTAPInitialStateInterface );
+    AddInterface( &mTAPStateResyncInterface );
     AddInterface( &mInstructRegBitOrderInterface );
     AddInterface( &mDataRegBitOrderInterface );
     AddInterface( &mShiftDRDataUnitInterface );
+    AddInterface( &mCollapseRepeatedScansInterface );
+    AddInterface( &mMarginThresholdInterface );
 
     AddInterface( &mShowBitCountInterface );
+    AddInterface( &mSearchQueryInterface );
+    AddInterface( &mFlashStreamInterface );
+    AddInterface( &mStoreFilterInterface );
+    AddInterface( &mBoundaryScanFileInterface );
+    AddInterface( &mPayloadMemoryLimitInterface );
+    AddInterface( &mCompressPayloadsInterface );
+    AddInterface( &mStreamingModeInterface );
 
     AddExportOption( 0, "Export as text/csv file" );
     AddExportExtension( 0, "csv", "csv" );
     AddExportExtension( 0, "text", "txt" );
 
+    AddExportOption( ExportSearchResults, "Export search results as text/csv file" );
+    AddExportExtension( ExportSearchResults, "csv", "csv" );
+    AddExportExtension( ExportSearchResults, "text", "txt" );
+
+    AddExportOption( ExportTimingHistogram, "Export TCK timing histogram as text/csv file" );
+    AddExportExtension( ExportTimingHistogram, "csv", "csv" );
+    AddExportExtension( ExportTimingHistogram, "text", "txt" );
+
+#ifdef JTAG_INSTRUMENTATION
+    AddExportOption( ExportInstrumentation, "Export decoder statistics as text/csv file" );
+    AddExportExtension( ExportInstrumentation, "csv", "csv" );
+    AddExportExtension( ExportInstrumentation, "text", "txt" );
+#endif
+
+    AddExportOption( ExportFlashImage, "Export flash stream as binary file" );
+    AddExportExtension( ExportFlashImage, "binary", "bin" );
+
+    AddExportOption( ExportValueChanges, "Export register value changes as text/csv file" );
+    AddExportExtension( ExportValueChanges, "csv", "csv" );
+    AddExportExtension( ExportValueChanges, "text", "txt" );
+
     ClearChannels();
 
     AddChannel( mTmsChannel, "TMS", false );
@@ -116,12 +266,60 @@ bool JtagAnalyzerSettings::SetSettingsFromInterfaces()
         return false;
     }
 
+    const WireProtocol wire_protocol = WireProtocol( int( mWireProtocolInterface.GetNumber() ) );
+    if( wire_protocol == TwoWireOScan1 && ( all_channels[ 2 ] != UNDEFINED_CHANNEL || all_channels[ 3 ] != UNDEFINED_CHANNEL ) )
+    {
+        SetErrorText( "cJTAG carries TDI and TDO on TMSC. Please select TMSC and TCKC as TMS and TCK, and no TDI and TDO channels." );
+        return false;
+    }
+
+    JtagSearchQuery search_query;
+    if( !search_query.Parse( mSearchQueryInterface.GetText() ) )
+    {
+        SetErrorText( "The search export should look like IR[:TDO[/MASK]], e.g. 0x0E:0x1234/0xFFFF." );
+        return false;
+    }
+
+    JtagFlashStreamConfig flash_stream_config;
+    if( !flash_stream_config.Parse( mFlashStreamInterface.GetText() ) )
+    {
+        SetErrorText( "The flash stream should look like IR[:FIRST_BIT[:BIT_COUNT]], e.g. 0x0C:1:32." );
+        return false;
+    }
+
+    JtagFrameFilterConfig store_filter_config;
+    if( !store_filter_config.Parse( mStoreFilterInterface.GetText() ) )
+    {
+        SetErrorText( "The store filter should look like states=Shift-DR,Update-DR; ir=0x0E; tdi=0x1/0x1; tdo=0x1234/0xFFFF, "
+                      "with any of the clauses left out." );
+        return false;
+    }
+
+    // without a limit, streaming would never drop anything
+    if( mStreamingModeInterface.GetValue() && mPayloadMemoryLimitInterface.GetInteger() == 0 )
+    {
+        SetErrorText( "Streaming drops the oldest TDI/TDO data over the memory limit. Please set a TDI/TDO memory limit above 0 MB." );
+        return false;
+    }
+
+    JtagBoundaryRegister boundary_register;
+    std::string boundary_scan_error;
+    if( !boundary_register.Load( mBoundaryScanFileInterface.GetText(), boundary_scan_error ) )
+    {
+        const std::string error_text = "Can't read the boundary-scan BSDL file: " + boundary_scan_error;
+        SetErrorText( error_text.c_str() );
+        return false;
+    }
+
     mTmsChannel = all_channels[ 0 ];
     mTckChannel = all_channels[ 1 ];
     mTdiChannel = all_channels[ 2 ];
     mTdoChannel = all_channels[ 3 ];
     mTrstChannel = all_channels[ 4 ];
 
+    mWireProtocol = wire_protocol;
+    mSuspendOutsideJtag = mSuspendOutsideJtagInterface.GetValue();
+
     ClearChannels();
 
     AddChannel( mTmsChannel, "TMS", true );
@@ -130,9 +328,16 @@ bool JtagAnalyzerSettings::SetSettingsFromInterfaces()
     AddChannel( mTdoChannel, "TDO", mTdoChannel != UNDEFINED_CHANNEL );
     AddChannel( mTrstChannel, "TRST", mTrstChannel != UNDEFINED_CHANNEL );
 
+    // where the data lines are sampled
+    mTmsSamplingEdge = SamplingEdge( int( mTmsSamplingEdgeInterface.GetNumber() ) );
+    mTdiSamplingEdge = SamplingEdge( int( mTdiSamplingEdgeInterface.GetNumber() ) );
+    mTdoSamplingEdge = SamplingEdge( int( mTdoSamplingEdgeInterface.GetNumber() ) );
+    mSamplingDelay = mSamplingDelayInterface.GetInteger();
+
     // the TAP initial state
     int cast2Int = int( mTAPInitialStateInterface.GetNumber() );
     mTAPInitialState = JtagTAPState( cast2Int );
+    mTAPStateResync = mTAPStateResyncInterface.GetValue();
 
     // the shift bit orders
     cast2Int = int( mInstructRegBitOrderInterface.GetNumber() );
@@ -142,9 +347,21 @@ bool JtagAnalyzerSettings::SetSettingsFromInterfaces()
     mDataRegBitOrder = BitOrder( cast2Int );
 
     mShiftDRBitsPerDataUnit = mShiftDRDataUnitInterface.GetInteger();
+    mCollapseRepeatedScans = mCollapseRepeatedScansInterface.GetValue();
+    mMarginThreshold = mMarginThresholdInterface.GetInteger();
 
     mShowBitCount = mShowBitCountInterface.GetValue();
 
+    mSearchQuery = mSearchQueryInterface.GetText();
+    mFlashStream = mFlashStreamInterface.GetText();
+    mStoreFilter = mStoreFilterInterface.GetText();
+    mBoundaryScanFile = mBoundaryScanFileInterface.GetText();
+    mBoundaryRegister = boundary_register;
+
+    mPayloadMemoryLimit = mPayloadMemoryLimitInterface.GetInteger();
+    mCompressPayloads = mCompressPayloadsInterface.GetValue();
+    mStreamingMode = mStreamingModeInterface.GetValue();
+
     return true;
 }
 
@@ -155,12 +372,29 @@ void JtagAnalyzerSettings::UpdateInterfacesFromSettings()
     mTdiChannelInterface.SetChannel( mTdiChannel );
     mTdoChannelInterface.SetChannel( mTdoChannel );
     mTrstChannelInterface.SetChannel( mTrstChannel );
+    mWireProtocolInterface.SetNumber( mWireProtocol );
+    mSuspendOutsideJtagInterface.SetValue( mSuspendOutsideJtag );
+
+    mTmsSamplingEdgeInterface.SetNumber( mTmsSamplingEdge );
+    mTdiSamplingEdgeInterface.SetNumber( mTdiSamplingEdge );
+    mTdoSamplingEdgeInterface.SetNumber( mTdoSamplingEdge );
+    mSamplingDelayInterface.SetInteger( mSamplingDelay );
 
     mTAPInitialStateInterface.SetNumber( mTAPInitialState );
+    mTAPStateResyncInterface.SetValue( mTAPStateResync );
     mInstructRegBitOrderInterface.SetNumber( mInstructRegBitOrder );
     mDataRegBitOrderInterface.SetNumber( mDataRegBitOrder );
     mShiftDRDataUnitInterface.SetInteger( mShiftDRBitsPerDataUnit );
+    mCollapseRepeatedScansInterface.SetValue( mCollapseRepeatedScans );
+    mMarginThresholdInterface.SetInteger( mMarginThreshold );
     mShowBitCountInterface.SetValue( mShowBitCount );
+    mSearchQueryInterface.SetText( mSearchQuery.c_str() );
+    mFlashStreamInterface.SetText( mFlashStream.c_str() );
+    mStoreFilterInterface.SetText( mStoreFilter.c_str() );
+    mBoundaryScanFileInterface.SetText( mBoundaryScanFile.c_str() );
+    mPayloadMemoryLimitInterface.SetInteger( mPayloadMemoryLimit );
+    mCompressPayloadsInterface.SetValue( mCompressPayloads );
+    mStreamingModeInterface.SetValue( mStreamingMode );
 }
 
 void JtagAnalyzerSettings::LoadSettings( const char* settings )
@@ -193,6 +427,67 @@ void JtagAnalyzerSettings::LoadSettings( const char* settings )
 
     text_archive >> mShowBitCount; // added after 1.2.3. Defaults false on failure to load.
 
+    text_archive >> mTAPStateResync; // defaults false on failure to load.
+
+    const char* search_query;
+    if( text_archive >> &search_query )
+        mSearchQuery = search_query;
+
+    U32 payload_memory_limit;
+    if( ( text_archive >> payload_memory_limit ) && payload_memory_limit <= 65536 )
+        mPayloadMemoryLimit = payload_memory_limit;
+
+    bool compress_payloads;
+    if( text_archive >> compress_payloads )
+        mCompressPayloads = compress_payloads;
+
+    text_archive >> mCollapseRepeatedScans;
+
+    U32 margin_threshold;
+    if( ( text_archive >> margin_threshold ) && margin_threshold <= 1000000 )
+        mMarginThreshold = margin_threshold;
+
+    SamplingEdge* sampling_edges[ 3 ] = { &mTmsSamplingEdge, &mTdiSamplingEdge, &mTdoSamplingEdge };
+    for( int line_idx = 0; line_idx < 3; ++line_idx )
+    {
+        if( ( text_archive >> ival ) && ival >= SampleOnRisingEdge && ival <= SampleOnNextRisingEdge )
+            *sampling_edges[ line_idx ] = SamplingEdge( ival );
+    }
+
+    U32 sampling_delay;
+    if( ( text_archive >> sampling_delay ) && sampling_delay <= 1000000 )
+        mSamplingDelay = sampling_delay;
+
+    const char* flash_stream;
+    if( text_archive >> &flash_stream )
+        mFlashStream = flash_stream;
+
+    // the file may have gone away since; the pins are then just not decoded
+    const char* boundary_scan_file;
+    if( text_archive >> &boundary_scan_file )
+        mBoundaryScanFile = boundary_scan_file;
+
+    std::string boundary_scan_error;
+    mBoundaryRegister.Load( mBoundaryScanFile, boundary_scan_error );
+
+    if( ( text_archive >> ival ) && ( ival == FourWireJtag || ival == TwoWireOScan1 ) )
+        mWireProtocol = WireProtocol( ival );
+
+    bool suspend_outside_jtag;
+    if( text_archive >> suspend_outside_jtag )
+        mSuspendOutsideJtag = suspend_outside_jtag;
+
+    const char* store_filter;
+    if( text_archive >> &store_filter )
+        mStoreFilter = store_filter;
+
+    bool streaming_mode;
+    if( text_archive >> streaming_mode )
+        mStreamingMode = streaming_mode;
+
+    // the interfaces don't allow streaming without a limit, but a settings string might
+    if( mStreamingMode && mPayloadMemoryLimit == 0 )
+        mPayloadMemoryLimit = DEFAULT_PAYLOAD_MEMORY_LIMIT;
 
     ClearChannels();
 
@@ -221,5 +516,58 @@ const char* JtagAnalyzerSettings::SaveSettings()
 
     text_archive << mShowBitCount; // added after 1.2.3
 
+    text_archive << mTAPStateResync;
+
+    text_archive << mSearchQuery.c_str();
+
+    text_archive << mPayloadMemoryLimit;
+    text_archive << mCompressPayloads;
+    text_archive << mCollapseRepeatedScans;
+    text_archive << mMarginThreshold;
+    text_archive << int( mTmsSamplingEdge );
+    text_archive << int( mTdiSamplingEdge );
+    text_archive << int( mTdoSamplingEdge );
+    text_archive << mSamplingDelay;
+    text_archive << mFlashStream.c_str();
+    text_archive << mBoundaryScanFile.c_str();
+    text_archive << int( mWireProtocol );
+    text_archive << mSuspendOutsideJtag;
+    text_archive << mStoreFilter.c_str();
+    text_archive << mStreamingMode;
+
     return SetReturnString( text_archive.GetString() );
 }
+
+std::string JtagAnalyzerSettings::GetDecodeSettings()
+{
+    SimpleArchive text_archive;
+
+    text_archive << mTmsChannel;
+    text_archive << mTckChannel;
+    text_archive << mTdiChannel;
+    text_archive << mTdoChannel;
+    text_archive << mTrstChannel;
+    text_archive << int( mTAPInitialState );
+    text_archive << mTAPStateResync;
+    text_archive << mShiftDRBitsPerDataUnit;
+    text_archive << mCollapseRepeatedScans;
+    text_archive << mMarginThreshold;
+    text_archive << int( mTmsSamplingEdge );
+    text_archive << int( mTdiSamplingEdge );
+    text_archive << int( mTdoSamplingEdge );
+    text_archive << mSamplingDelay;
+    text_archive << mFlashStream.c_str();
+    text_archive << mBoundaryScanFile.c_str();
+    text_archive << int( mWireProtocol );
+    text_archive << mSuspendOutsideJtag;
+    text_archive << mStoreFilter.c_str();
+
+    // with streaming, the dropped TDI/TDO data can only come back by decoding again
+    text_archive << mStreamingMode;
+
+    // the payload arena is set up with these when the results are made
+    text_archive << mPayloadMemoryLimit;
+    text_archive << mCompressPayloads;
+
+    return text_archive.GetString();
+}
@@ -4,6 +4,7 @@
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
 
+#include "JtagBoundaryScan.h"
 #include "JtagTypes.h"
 
 enum BitOrder
@@ -12,6 +13,32 @@ enum BitOrder
     LSB_First,
 };
 
+// how the TAP is wired
+enum WireProtocol
+{
+    FourWireJtag,  // IEEE 1149.1 TMS, TCK, TDI and TDO
+    TwoWireOScan1, // IEEE 1149.7 cJTAG OScan1, with TMSC on the TMS channel and TCKC on the TCK channel
+};
+
+// where a data line is sampled for a clock
+enum SamplingEdge
+{
+    SampleOnRisingEdge,     // the TCK rising edge of the clock
+    SampleOnFallingEdge,    // the TCK falling edge after it
+    SampleOnNextRisingEdge, // the TCK rising edge of the next clock
+};
+
+// export_type_user_id of the export options
+enum ExportType
+{
+    ExportText,
+    ExportSearchResults,
+    ExportTimingHistogram,
+    ExportInstrumentation, // only with JTAG_INSTRUMENTATION
+    ExportFlashImage,
+    ExportValueChanges,
+};
+
 class JtagAnalyzerSettings : public AnalyzerSettings
 {
   public:
@@ -24,13 +51,46 @@ class JtagAnalyzerSettings : public AnalyzerSettings
 
     void UpdateInterfacesFromSettings();
 
+    // the settings that change the decoded frames; the rest only affect how results are presented.
+    // The bit orders are left out, see JtagAnalyzer::NeedsRerun.
+    std::string GetDecodeSettings();
+
+    bool IsShiftedLsbFirst( JtagTAPState shift_state ) const
+    {
+        return ( shift_state == ShiftIR ? mInstructRegBitOrder : mDataRegBitOrder ) == LSB_First;
+    }
+
+    // whether TDI/TDO are decoded, from their own channels or from TMSC
+    bool HasTdi() const
+    {
+        return mWireProtocol == TwoWireOScan1 || mTdiChannel != UNDEFINED_CHANNEL;
+    }
+
+    bool HasTdo() const
+    {
+        return mWireProtocol == TwoWireOScan1 || mTdoChannel != UNDEFINED_CHANNEL;
+    }
+
     Channel mTmsChannel;
     Channel mTckChannel;
     Channel mTdiChannel;
     Channel mTdoChannel;
     Channel mTrstChannel;
 
+    WireProtocol mWireProtocol;
+
+    // an ARM SWJ-DP switching to SWD or dormant suspends the decoding until it's back in JTAG mode
+    bool mSuspendOutsideJtag;
+
+    SamplingEdge mTmsSamplingEdge;
+    SamplingEdge mTdiSamplingEdge;
+    SamplingEdge mTdoSamplingEdge;
+
+    // ns from the sampling edge to where the data lines are read
+    U32 mSamplingDelay;
+
     JtagTAPState mTAPInitialState;
+    bool mTAPStateResync;
 
     BitOrder mInstructRegBitOrder;
     BitOrder mDataRegBitOrder;
@@ -39,6 +99,32 @@ class JtagAnalyzerSettings : public AnalyzerSettings
 
     U32 mShiftDRBitsPerDataUnit;
 
+    bool mCollapseRepeatedScans;
+
+    // TMS/TDI/TDO changes closer than this many ns to a TCK rising edge flag the frame, 0 to not check
+    U32 mMarginThreshold;
+
+    // IR[:TDO[/MASK]] of the scans in the search export
+    std::string mSearchQuery;
+
+    // IR[:FIRST_BIT[:BIT_COUNT]] of the DR scans carrying flash programming data
+    std::string mFlashStream;
+
+    // which frames go into the results, see JtagFrameFilterConfig
+    std::string mStoreFilter;
+
+    // BSDL file of the device, and the boundary register read from it when the settings are set or loaded
+    std::string mBoundaryScanFile;
+    JtagBoundaryRegister mBoundaryRegister;
+
+    // MB of TDI/TDO data kept in memory before the rest goes to a temporary file, 0 for no limit
+    U32 mPayloadMemoryLimit;
+    bool mCompressPayloads;
+
+    // for captures that run indefinitely: TDI/TDO data over the memory limit is dropped, the oldest first,
+    // and results are committed on a time budget. Needs a memory limit.
+    bool mStreamingMode;
+
   protected:
     AnalyzerSettingInterfaceChannel mTmsChannelInterface;
     AnalyzerSettingInterfaceChannel mTckChannelInterface;
@@ -46,13 +132,33 @@ class JtagAnalyzerSettings : public AnalyzerSettings
     AnalyzerSettingInterfaceChannel mTdoChannelInterface;
     AnalyzerSettingInterfaceChannel mTrstChannelInterface;
 
+    AnalyzerSettingInterfaceNumberList mWireProtocolInterface;
+    AnalyzerSettingInterfaceBool mSuspendOutsideJtagInterface;
+
+    AnalyzerSettingInterfaceNumberList mTmsSamplingEdgeInterface;
+    AnalyzerSettingInterfaceNumberList mTdiSamplingEdgeInterface;
+    AnalyzerSettingInterfaceNumberList mTdoSamplingEdgeInterface;
+    AnalyzerSettingInterfaceInteger mSamplingDelayInterface;
+
     AnalyzerSettingInterfaceNumberList mTAPInitialStateInterface;
+    AnalyzerSettingInterfaceBool mTAPStateResyncInterface;
 
     AnalyzerSettingInterfaceNumberList mInstructRegBitOrderInterface;
     AnalyzerSettingInterfaceNumberList mDataRegBitOrderInterface;
     AnalyzerSettingInterfaceInteger mShiftDRDataUnitInterface;
+    AnalyzerSettingInterfaceBool mCollapseRepeatedScansInterface;
+    AnalyzerSettingInterfaceInteger mMarginThresholdInterface;
 
     AnalyzerSettingInterfaceBool mShowBitCountInterface;
+
+    AnalyzerSettingInterfaceText mSearchQueryInterface;
+    AnalyzerSettingInterfaceText mFlashStreamInterface;
+    AnalyzerSettingInterfaceText mStoreFilterInterface;
+    AnalyzerSettingInterfaceText mBoundaryScanFileInterface;
+
+    AnalyzerSettingInterfaceInteger mPayloadMemoryLimitInterface;
+    AnalyzerSettingInterfaceBool mCompressPayloadsInterface;
+    AnalyzerSettingInterfaceBool mStreamingModeInterface;
 };
 
 #endif // JTAG_ANALYZER_SETTINGS_H
@@ -0,0 +1,332 @@
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "JtagBoundaryScan.h"
+
+// the instructions that put the boundary register between TDI and TDO
+static const char* BOUNDARY_INSTRUCTIONS[] = { "SAMPLE", "PRELOAD", "EXTEST" };
+
+static std::string ToUpper( const std::string& str )
+{
+    std::string upper( str );
+    for( std::string::iterator si( upper.begin() ); si != upper.end(); ++si )
+        *si = char( toupper( U8( *si ) ) );
+    return upper;
+}
+
+static std::string Trim( const std::string& str )
+{
+    const size_t begin = str.find_first_not_of( " \t\r\n" );
+    if( begin == std::string::npos )
+        return std::string();
+
+    return str.substr( begin, str.find_last_not_of( " \t\r\n" ) + 1 - begin );
+}
+
+// the concatenated strings of a BSDL attribute, e.g. attribute NAME of entity : entity is "..." & "...";
+static bool GetAttribute( const std::string& bsdl, const std::string& name, std::string& value )
+{
+    const std::string upper_bsdl = ToUpper( bsdl );
+
+    size_t pos = 0;
+    while( ( pos = upper_bsdl.find( "ATTRIBUTE", pos ) ) != std::string::npos )
+    {
+        pos += 9;
+
+        std::istringstream words( upper_bsdl.substr( pos, name.size() + 64 ) );
+        std::string word;
+        if( !( words >> word ) || word != name )
+            continue;
+
+        const size_t end = bsdl.find( ';', pos );
+        if( end == std::string::npos )
+            return false;
+
+        value.clear();
+
+        size_t quote = pos;
+        while( ( quote = bsdl.find( '"', quote ) ) < end )
+        {
+            const size_t closing_quote = bsdl.find( '"', quote + 1 );
+            if( closing_quote == std::string::npos || closing_quote > end )
+                return false;
+
+            value += bsdl.substr( quote + 1, closing_quote - quote - 1 );
+            quote = closing_quote + 1;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+// splits "A (x, y), B (z(1), w)" into its entries, and each entry into its name and fields
+struct BsdlEntry
+{
+    std::string mName;
+    std::vector<std::string> mFields;
+};
+
+static bool SplitEntries( const std::string& value, std::vector<BsdlEntry>& entries )
+{
+    entries.clear();
+
+    size_t pos = 0;
+    for( ;; )
+    {
+        const size_t open_paren = value.find( '(', pos );
+        if( open_paren == std::string::npos )
+            return Trim( value.substr( pos ) ).empty();
+
+        BsdlEntry entry;
+        entry.mName = Trim( value.substr( pos, open_paren - pos ) );
+        if( entry.mName.empty() )
+            return false;
+
+        // fields are split at the commas outside nested parentheses, like the one of a port index
+        int depth = 0;
+        std::string field;
+        for( pos = open_paren + 1; pos < value.size(); ++pos )
+        {
+            const char ch = value[ pos ];
+            if( ch == '(' )
+                ++depth;
+            else if( ch == ')' && depth-- == 0 )
+                break;
+
+            if( ch == ',' && depth == 0 )
+            {
+                entry.mFields.push_back( Trim( field ) );
+                field.clear();
+            }
+            else
+                field += ch;
+        }
+
+        if( pos == value.size() )
+            return false;
+
+        entry.mFields.push_back( Trim( field ) );
+        entries.push_back( entry );
+
+        pos = value.find_first_not_of( " \t\r\n", pos + 1 );
+        if( pos == std::string::npos )
+            return true;
+        if( value[ pos ] != ',' )
+            return false;
+        ++pos;
+    }
+}
+
+JtagBoundaryRegister::JtagBoundaryRegister()
+{
+}
+
+void JtagBoundaryRegister::Clear()
+{
+    mInstructions.clear();
+    mCellLabels.clear();
+}
+
+bool JtagBoundaryRegister::Load( const std::string& path, std::string& error )
+{
+    Clear();
+
+    if( path.empty() )
+        return true;
+
+    std::ifstream file_stream( path.c_str() );
+    if( !file_stream )
+    {
+        error = "can't open " + path;
+        return false;
+    }
+
+    // without the comments, which run from -- to the end of the line
+    std::string bsdl, line;
+    while( std::getline( file_stream, line ) )
+        bsdl += line.substr( 0, line.find( "--" ) ) + "\n";
+
+    std::string attribute;
+    if( !GetAttribute( bsdl, "INSTRUCTION_OPCODE", attribute ) )
+    {
+        error = "no INSTRUCTION_OPCODE attribute";
+        return false;
+    }
+
+    if( !ParseOpcodes( attribute, error ) )
+    {
+        Clear();
+        return false;
+    }
+
+    if( !GetAttribute( bsdl, "BOUNDARY_REGISTER", attribute ) )
+    {
+        Clear();
+        error = "no BOUNDARY_REGISTER attribute";
+        return false;
+    }
+
+    if( !ParseCells( attribute, error ) )
+    {
+        Clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool JtagBoundaryRegister::ParseOpcodes( const std::string& attribute, std::string& error )
+{
+    std::vector<BsdlEntry> entries;
+    if( !SplitEntries( attribute, entries ) )
+    {
+        error = "can't parse INSTRUCTION_OPCODE";
+        return false;
+    }
+
+    for( std::vector<BsdlEntry>::const_iterator ei( entries.begin() ); ei != entries.end(); ++ei )
+    {
+        const std::string name = ToUpper( ei->mName );
+
+        bool is_boundary_instruction = false;
+        for( size_t instruction_idx = 0; instruction_idx < sizeof( BOUNDARY_INSTRUCTIONS ) / sizeof( BOUNDARY_INSTRUCTIONS[ 0 ] );
+             ++instruction_idx )
+            is_boundary_instruction |= ( name == BOUNDARY_INSTRUCTIONS[ instruction_idx ] );
+
+        if( !is_boundary_instruction )
+            continue;
+
+        // opcodes are written MSB first; ones with don't care bits can't be matched against a value
+        for( std::vector<std::string>::const_iterator fi( ei->mFields.begin() ); fi != ei->mFields.end(); ++fi )
+            if( !fi->empty() && fi->size() <= 64 && fi->find_first_not_of( "01" ) == std::string::npos )
+                mInstructions[ strtoull( fi->c_str(), NULL, 2 ) ] = name;
+    }
+
+    if( mInstructions.empty() )
+    {
+        error = "no SAMPLE, PRELOAD or EXTEST opcode";
+        return false;
+    }
+
+    return true;
+}
+
+bool JtagBoundaryRegister::ParseCells( const std::string& attribute, std::string& error )
+{
+    std::vector<BsdlEntry> entries;
+    if( !SplitEntries( attribute, entries ) )
+    {
+        error = "can't parse BOUNDARY_REGISTER";
+        return false;
+    }
+
+    for( std::vector<BsdlEntry>::const_iterator ei( entries.begin() ); ei != entries.end(); ++ei )
+    {
+        char* end;
+        const U64 cell = strtoull( ei->mName.c_str(), &end, 10 );
+
+        // cell type, port, function, safe value[, control cell, disable value, disable result]
+        if( *end != '\0' || ei->mFields.size() < 4 )
+        {
+            error = "can't parse BOUNDARY_REGISTER cell " + ei->mName;
+            return false;
+        }
+
+        // thousands of cells is usual; a much larger number is a typo
+        if( cell >= 1 << 20 )
+        {
+            error = "BOUNDARY_REGISTER cell " + ei->mName + " is out of range";
+            return false;
+        }
+
+        if( cell >= mCellLabels.size() )
+            mCellLabels.resize( size_t( cell + 1 ) );
+
+        const std::string& port = ei->mFields[ 1 ];
+        const std::string function = ToUpper( ei->mFields[ 2 ] );
+
+        if( function == "INTERNAL" )
+            mCellLabels[ size_t( cell ) ].clear();
+        else if( port == "*" )
+            mCellLabels[ size_t( cell ) ] = "cell" + ei->mName + "." + ei->mFields[ 2 ];
+        else
+            mCellLabels[ size_t( cell ) ] = port + "." + ei->mFields[ 2 ];
+    }
+
+    if( mCellLabels.empty() )
+    {
+        error = "no BOUNDARY_REGISTER cells";
+        return false;
+    }
+
+    return true;
+}
+
+const char* JtagBoundaryRegister::GetInstructionName( U64 instruction ) const
+{
+    std::unordered_map<U64, std::string>::const_iterator ii( mInstructions.find( instruction ) );
+    return ii == mInstructions.end() ? NULL : ii->second.c_str();
+}
+
+JtagBoundaryDiff::JtagBoundaryDiff() : mHasPrevScan( false )
+{
+}
+
+void JtagBoundaryDiff::Clear()
+{
+    mHasPrevScan = false;
+    mPrevScan.Clear();
+}
+
+// the index of the lowest set bit of a non-zero value
+static U32 LowestSetBit( U64 value )
+{
+    static const U8 DE_BRUIJN_BITS[ 64 ] = { 0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,  62, 55, 59, 36, 53, 51,
+                                             43, 22, 45, 39, 33, 30, 24, 18, 12, 5,  63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21,
+                                             44, 32, 23, 11, 46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6 };
+
+    return DE_BRUIJN_BITS[ ( ( value & ( 0 - value ) ) * 0x03F79D71B4CB0A89ULL ) >> 58 ];
+}
+
+U64 JtagBoundaryDiff::Diff( const JtagBoundaryRegister& boundary_register, const JtagPackedBits& bits, std::string& changes )
+{
+    const U64 bit_count = bits.GetBitCount();
+    const U64* words = bits.GetWords();
+    const U64* prev_words = mHasPrevScan ? mPrevScan.GetWords() : NULL;
+    const U64 word_count = ( bit_count + 63 ) / 64;
+
+    U64 changed_count = 0;
+
+    for( U64 word_idx = 0; word_idx < word_count; ++word_idx )
+    {
+        U64 changed = prev_words != NULL ? words[ word_idx ] ^ prev_words[ word_idx ] : ~0ULL;
+        if( word_idx == word_count - 1 && ( bit_count & 63 ) != 0 )
+            changed &= ( 1ULL << ( bit_count & 63 ) ) - 1;
+
+        while( changed != 0 )
+        {
+            const U64 cell = word_idx * 64 + LowestSetBit( changed );
+            changed &= changed - 1;
+
+            const std::string& label = boundary_register.GetCellLabel( cell );
+            if( label.empty() )
+                continue;
+
+            if( !changes.empty() )
+                changes += ' ';
+            changes += label;
+            changes += ( ( words[ word_idx ] >> ( cell & 63 ) ) & 1 ) ? "=1" : "=0";
+
+            ++changed_count;
+        }
+    }
+
+    mPrevScan = bits;
+    mHasPrevScan = true;
+
+    return changed_count;
+}
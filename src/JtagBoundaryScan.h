@@ -0,0 +1,70 @@
+#ifndef JTAG_BOUNDARY_SCAN_H
+#define JTAG_BOUNDARY_SCAN_H
+
+#include <LogicPublicTypes.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JtagTypes.h"
+
+// The boundary register of a device, read from the INSTRUCTION_OPCODE and BOUNDARY_REGISTER
+// attributes of its BSDL file. Only the instructions that select the boundary register are kept.
+// Cell 0 is the cell next to TDO, so it holds the first bit shifted in and out.
+class JtagBoundaryRegister
+{
+  public:
+    JtagBoundaryRegister();
+
+    // an empty path clears the description; on failure, error says what was wrong
+    bool Load( const std::string& path, std::string& error );
+    void Clear();
+
+    bool IsLoaded() const
+    {
+        return !mCellLabels.empty();
+    }
+
+    U64 GetLength() const
+    {
+        return mCellLabels.size();
+    }
+
+    // the name of the SAMPLE, PRELOAD or EXTEST instruction with the opcode, or NULL
+    const char* GetInstructionName( U64 instruction ) const;
+
+    // "<port>.<function>", or "cell<N>.<function>" for cells without a port; empty for internal cells
+    const std::string& GetCellLabel( U64 cell ) const
+    {
+        return mCellLabels[ cell ];
+    }
+
+  protected:
+    bool ParseOpcodes( const std::string& attribute, std::string& error );
+    bool ParseCells( const std::string& attribute, std::string& error );
+
+    // opcode -> instruction name
+    std::unordered_map<U64, std::string> mInstructions;
+    std::vector<std::string> mCellLabels;
+};
+
+// Finds the cells that changed since the previous boundary scan, a word at a time
+class JtagBoundaryDiff
+{
+  public:
+    JtagBoundaryDiff();
+
+    void Clear();
+
+    // appends "label=value" of the changed cells to changes, separated by spaces, and returns how many
+    // cells changed. The first scan compares against nothing, so every cell is reported. The bits must
+    // be as long as the boundary register.
+    U64 Diff( const JtagBoundaryRegister& boundary_register, const JtagPackedBits& bits, std::string& changes );
+
+  protected:
+    bool mHasPrevScan;
+    JtagPackedBits mPrevScan;
+};
+
+#endif // JTAG_BOUNDARY_SCAN_H
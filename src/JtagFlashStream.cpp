@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "JtagFlashStream.h"
+#include "JtagRepeatDetector.h"
+
+JtagFlashStreamConfig::JtagFlashStreamConfig() : mEnabled( false ), mInstruction( 0 ), mFirstBit( 0 ), mBitCount( 0 )
+{
+}
+
+// parses a whole number in C notation (0x.., 0.., decimal)
+static bool ParseNumber( const std::string& str, U64& value )
+{
+    if( str.empty() )
+        return false;
+
+    char* end;
+    value = strtoull( str.c_str(), &end, 0 );
+
+    return *end == '\0';
+}
+
+bool JtagFlashStreamConfig::Parse( const std::string& config )
+{
+    *this = JtagFlashStreamConfig();
+
+    std::string str;
+    for( std::string::const_iterator ci( config.begin() ); ci != config.end(); ++ci )
+        if( *ci != ' ' )
+            str += *ci;
+
+    if( str.empty() )
+        return true;
+
+    std::vector<std::string> fields;
+    size_t field_begin = 0;
+    for( ;; )
+    {
+        const size_t colon_pos = str.find( ':', field_begin );
+        fields.push_back( str.substr( field_begin, colon_pos - field_begin ) );
+        if( colon_pos == std::string::npos )
+            break;
+        field_begin = colon_pos + 1;
+    }
+
+    if( fields.size() > 3 || !ParseNumber( fields[ 0 ], mInstruction ) )
+        return false;
+
+    if( fields.size() > 1 && !ParseNumber( fields[ 1 ], mFirstBit ) )
+        return false;
+
+    if( fields.size() > 2 && !ParseNumber( fields[ 2 ], mBitCount ) )
+        return false;
+
+    mEnabled = true;
+
+    return true;
+}
+
+JtagFlashStream::JtagFlashStream()
+    : mLsbFirst( true ), mSelected( false ), mPendingStartingSample( 0 ), mScanCount( 0 ), mStartingSample( 0 ), mEndingSample( 0 )
+{
+    PushScanEnd();
+}
+
+void JtagFlashStream::Init( const JtagFlashStreamConfig& config, bool lsb_first )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    mConfig = config;
+    mLsbFirst = lsb_first;
+
+    mSelected = false;
+    mPendingBits.Clear();
+    mImage.clear();
+    mScanCount = 0;
+
+    mScanEnds.clear();
+    PushScanEnd();
+}
+
+void JtagFlashStream::SetInstruction( bool instruction_known, U64 instruction )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    mSelected = mConfig.mEnabled && instruction_known && instruction == mConfig.mInstruction;
+
+    // Test-Logic-Reset in the middle of a scan
+    mPendingBits.Clear();
+}
+
+void JtagFlashStream::AddShiftBits( const Frame& frame, const JtagPackedBits& tdi_bits )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    if( !mSelected )
+        return;
+
+    if( mPendingBits.GetBitCount() == 0 )
+        mPendingStartingSample = frame.mStartingSampleInclusive;
+
+    mPendingBits.Append( tdi_bits );
+}
+
+void JtagFlashStream::EndScan( const Frame& frame )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    if( mPendingBits.GetBitCount() > mConfig.mFirstBit )
+    {
+        if( mScanCount == 0 )
+            mStartingSample = mPendingStartingSample;
+        mEndingSample = frame.mEndingSampleInclusive;
+        ++mScanCount;
+
+        AppendField();
+    }
+
+    mPendingBits.Clear();
+    PushScanEnd();
+}
+
+void JtagFlashStream::AppendField()
+{
+    U64 bit_count = mPendingBits.GetBitCount() - mConfig.mFirstBit;
+    if( mConfig.mBitCount != 0 )
+        bit_count = std::min( bit_count, mConfig.mBitCount );
+
+    // in shift order, so the values come out with the first shifted bit as the most significant one
+    const JtagBitView bits( mPendingBits, false );
+
+    for( U64 bit_index = 0; bit_index < bit_count; bit_index += 8 )
+    {
+        // a partial last byte is padded with zeros after the last bit
+        const U64 byte_bits = std::min<U64>( 8, bit_count - bit_index );
+        U8 byte = U8( bits.GetValue( mConfig.mFirstBit + bit_index, byte_bits ) << ( 8 - byte_bits ) );
+
+        if( mLsbFirst )
+            byte = U8( JtagBitView::ReverseBits( byte ) >> 56 );
+
+        mImage.push_back( byte );
+    }
+}
+
+void JtagFlashStream::PushScanEnd()
+{
+    ScanEnd scan_end;
+    scan_end.mByteCount = mImage.size();
+    scan_end.mScanCount = mScanCount;
+    mScanEnds.push_back( scan_end );
+
+    if( mScanEnds.size() > JtagRepeatDetector::MAX_REPEAT_SCANS + 1 )
+        mScanEnds.pop_front();
+}
+
+void JtagFlashStream::RepeatScans( const Frame& frame )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    const U64 repeat_count = frame.mData1;
+    const size_t repeat_scans = size_t( frame.mData2 );
+    if( repeat_scans == 0 || repeat_scans >= mScanEnds.size() )
+        return;
+
+    // what each scan of the repeated block added
+    std::vector<ScanEnd> block_scans;
+    for( size_t scan_idx = mScanEnds.size() - repeat_scans; scan_idx < mScanEnds.size(); ++scan_idx )
+    {
+        ScanEnd scan_added;
+        scan_added.mByteCount = mScanEnds[ scan_idx ].mByteCount - mScanEnds[ scan_idx - 1 ].mByteCount;
+        scan_added.mScanCount = mScanEnds[ scan_idx ].mScanCount - mScanEnds[ scan_idx - 1 ].mScanCount;
+        block_scans.push_back( scan_added );
+    }
+
+    const size_t block_begin = size_t( mScanEnds[ mScanEnds.size() - 1 - repeat_scans ].mByteCount );
+    const std::vector<U8> block( mImage.begin() + block_begin, mImage.end() );
+    const U64 block_scan_count = mScanCount - mScanEnds[ mScanEnds.size() - 1 - repeat_scans ].mScanCount;
+
+    if( block_scan_count == 0 )
+        return;
+
+    mImage.reserve( mImage.size() + block.size() * repeat_count );
+
+    for( U64 repeat = 0; repeat < repeat_count; ++repeat )
+    {
+        std::vector<U8>::const_iterator bi( block.begin() );
+        for( std::vector<ScanEnd>::const_iterator si( block_scans.begin() ); si != block_scans.end(); ++si )
+        {
+            mImage.insert( mImage.end(), bi, bi + si->mByteCount );
+            bi += si->mByteCount;
+            mScanCount += si->mScanCount;
+            PushScanEnd();
+        }
+    }
+
+    mEndingSample = frame.mEndingSampleInclusive;
+}
+
+void JtagFlashStream::WriteImage( std::ostream& stream )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    if( !mImage.empty() )
+        stream.write( reinterpret_cast<const char*>( &mImage[ 0 ] ), mImage.size() );
+}
+
+U64 JtagFlashStream::GetByteCount()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    return mImage.size();
+}
+
+U64 JtagFlashStream::GetScanCount()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    return mScanCount;
+}
+
+bool JtagFlashStream::GetTransferSamples( U64& starting_sample, U64& ending_sample )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    starting_sample = mStartingSample;
+    ending_sample = mEndingSample;
+
+    return mScanCount != 0;
+}
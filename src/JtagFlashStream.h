@@ -0,0 +1,94 @@
+#ifndef JTAG_FLASH_STREAM_H
+#define JTAG_FLASH_STREAM_H
+
+#include <LogicPublicTypes.h>
+
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "JtagTypes.h"
+
+// Which DR scans carry flash programming data, parsed from "IR[:FIRST_BIT[:BIT_COUNT]]", e.g. "0x0C:1:32".
+// FIRST_BIT and BIT_COUNT pick the data field of the scan, counted in the order the bits are shifted.
+// Without a BIT_COUNT, or with 0, the field is the rest of the scan. An empty string turns the stream off.
+struct JtagFlashStreamConfig
+{
+    JtagFlashStreamConfig();
+
+    // returns false if the config can't be parsed
+    bool Parse( const std::string& config );
+
+    bool mEnabled;
+    U64 mInstruction;
+    U64 mFirstBit;
+    U64 mBitCount;
+};
+
+// Concatenates the TDI data field of the DR scans made while the flash instruction was loaded into a
+// binary image, and keeps track of how long the transfer took. Frames are added in order as they go
+// into the results, so a Pause-DR in the middle of a scan and collapsed repeated scans are taken into account.
+class JtagFlashStream
+{
+  public:
+    JtagFlashStream();
+
+    // with lsb_first, the first data bit shifted is bit 0 of the first byte, otherwise it's bit 7
+    void Init( const JtagFlashStreamConfig& config, bool lsb_first );
+
+    bool IsEnabled() const
+    {
+        return mConfig.mEnabled;
+    }
+
+    // the instruction loaded by Update-IR, or none after Test-Logic-Reset
+    void SetInstruction( bool instruction_known, U64 instruction );
+
+    void AddShiftBits( const Frame& frame, const JtagPackedBits& tdi_bits );
+
+    // at Update-IR and Update-DR, the frames that end a scan
+    void EndScan( const Frame& frame );
+
+    // a JTAG_REPEATED_SCANS_FRAME, repeating the data of the scans before it
+    void RepeatScans( const Frame& frame );
+
+    void WriteImage( std::ostream& stream );
+
+    U64 GetByteCount();
+    U64 GetScanCount();
+
+    // from the start of the first data scan to the end of the last one; false without data scans
+    bool GetTransferSamples( U64& starting_sample, U64& ending_sample );
+
+  protected:
+    // the image size and data scan count at the end of a scan
+    struct ScanEnd
+    {
+        U64 mByteCount;
+        U64 mScanCount;
+    };
+
+    void AppendField();
+    void PushScanEnd();
+
+    JtagFlashStreamConfig mConfig;
+    bool mLsbFirst;
+
+    bool mSelected;
+    JtagPackedBits mPendingBits;
+    U64 mPendingStartingSample;
+
+    std::vector<U8> mImage;
+    U64 mScanCount;
+    U64 mStartingSample;
+    U64 mEndingSample;
+
+    // the ends of the last scans, enough for the longest repeat
+    std::deque<ScanEnd> mScanEnds;
+
+    std::mutex mMutex;
+};
+
+#endif // JTAG_FLASH_STREAM_H
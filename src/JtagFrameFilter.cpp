@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+#include "JtagAnalyzerResults.h"
+#include "JtagFrameFilter.h"
+#include "JtagRepeatDetector.h"
+
+JtagFrameFilterConfig::JtagFrameFilterConfig() : mEnabled( false ), mStates( ALL_TAP_STATES_MASK )
+{
+}
+
+// parses a whole number in C notation (0x.., 0.., decimal)
+static bool ParseNumber( const std::string& str, U64& value )
+{
+    if( str.empty() )
+        return false;
+
+    char* end;
+    value = strtoull( str.c_str(), &end, 0 );
+
+    return *end == '\0';
+}
+
+// like ParseNumber, but hex numbers can have any number of digits; least significant word first
+static bool ParseWords( const std::string& str, std::vector<U64>& words )
+{
+    words.clear();
+
+    if( str.size() <= 18 || str[ 0 ] != '0' || ( str[ 1 ] != 'x' && str[ 1 ] != 'X' ) )
+    {
+        U64 value;
+        if( !ParseNumber( str, value ) )
+            return false;
+
+        words.push_back( value );
+        return true;
+    }
+
+    for( size_t digits_end = str.size(); digits_end > 2; )
+    {
+        const size_t digits_begin = std::max( size_t( 2 ), digits_end - std::min( digits_end, size_t( 16 ) ) );
+
+        U64 value;
+        if( !ParseNumber( "0x" + str.substr( digits_begin, digits_end - digits_begin ), value ) )
+            return false;
+
+        words.push_back( value );
+        digits_end = digits_begin;
+    }
+
+    return true;
+}
+
+// VALUE[/MASK]; without a mask, all bits of the value's words are compared
+static bool ParsePattern( const std::string& str, JtagFramePattern& pattern )
+{
+    const size_t slash_pos = str.find( '/' );
+
+    if( !ParseWords( str.substr( 0, slash_pos ), pattern.mValue ) )
+        return false;
+
+    if( slash_pos == std::string::npos )
+        pattern.mMask.assign( pattern.mValue.size(), ~0ULL );
+    else if( !ParseWords( str.substr( slash_pos + 1 ), pattern.mMask ) )
+        return false;
+
+    const size_t word_count = std::max( pattern.mValue.size(), pattern.mMask.size() );
+    pattern.mValue.resize( word_count, 0 );
+    pattern.mMask.resize( word_count, 0 );
+
+    for( size_t word_idx = 0; word_idx < word_count; ++word_idx )
+        pattern.mValue[ word_idx ] &= pattern.mMask[ word_idx ];
+
+    return true;
+}
+
+static std::string ToLower( const std::string& str )
+{
+    std::string lower( str );
+    for( std::string::iterator si( lower.begin() ); si != lower.end(); ++si )
+        *si = char( tolower( U8( *si ) ) );
+    return lower;
+}
+
+static bool ParseState( const std::string& str, JtagTAPState& state )
+{
+    const std::string name = ToLower( str );
+
+    for( int state_cnt = 0; state_cnt < NUM_TAP_STATES; ++state_cnt )
+    {
+        if( name == ToLower( JtagAnalyzerResults::GetStateDescLong( JtagTAPState( state_cnt ) ) ) ||
+            name == ToLower( JtagAnalyzerResults::GetStateDescShort( JtagTAPState( state_cnt ) ) ) )
+        {
+            state = JtagTAPState( state_cnt );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool JtagFrameFilterConfig::Parse( const std::string& config )
+{
+    *this = JtagFrameFilterConfig();
+
+    std::string str;
+    for( std::string::const_iterator ci( config.begin() ); ci != config.end(); ++ci )
+        if( *ci != ' ' )
+            str += *ci;
+
+    size_t clause_begin = 0;
+    while( clause_begin < str.size() )
+    {
+        size_t clause_end = str.find( ';', clause_begin );
+        if( clause_end == std::string::npos )
+            clause_end = str.size();
+
+        const std::string clause = str.substr( clause_begin, clause_end - clause_begin );
+        clause_begin = clause_end + 1;
+
+        if( clause.empty() )
+            continue;
+
+        const size_t equals_pos = clause.find( '=' );
+        if( equals_pos == std::string::npos )
+            return false;
+
+        const std::string key = ToLower( clause.substr( 0, equals_pos ) );
+        if( key == "states" )
+            mStates = 0;
+
+        // the comma separated list after the '='
+        size_t item_begin = equals_pos + 1;
+        for( ;; )
+        {
+            const size_t comma_pos = clause.find( ',', item_begin );
+            const std::string item = clause.substr( item_begin, comma_pos - item_begin );
+
+            if( key == "states" )
+            {
+                JtagTAPState state;
+                if( !ParseState( item, state ) )
+                    return false;
+                mStates |= U16( 1 << state );
+            }
+            else if( key == "ir" )
+            {
+                U64 instruction;
+                if( !ParseNumber( item, instruction ) )
+                    return false;
+                mInstructions.push_back( instruction );
+            }
+            else if( key == "tdi" || key == "tdo" )
+            {
+                JtagFramePattern pattern;
+                if( !ParsePattern( item, pattern ) )
+                    return false;
+                ( key == "tdi" ? mTdiPatterns : mTdoPatterns ).push_back( pattern );
+            }
+            else
+                return false;
+
+            if( comma_pos == std::string::npos )
+                break;
+            item_begin = comma_pos + 1;
+        }
+
+        mEnabled = true;
+    }
+
+    return true;
+}
+
+JtagFrameFilter::JtagFrameFilter()
+    : mIrLsbFirst( true ), mDrLsbFirst( true ), mInstructionKnown( false ), mInstruction( 0 ), mScanStored( false ), mDroppedCount( 0 )
+{
+}
+
+void JtagFrameFilter::Init( const JtagFrameFilterConfig& config, bool ir_lsb_first, bool dr_lsb_first )
+{
+    mConfig = config;
+    mIrLsbFirst = ir_lsb_first;
+    mDrLsbFirst = dr_lsb_first;
+
+    mPendingInstruction.Clear();
+    mInstructionKnown = false;
+    mInstruction = 0;
+
+    mScanStored = false;
+    mRecentScansStored.clear();
+
+    mDroppedCount = 0;
+}
+
+bool JtagFrameFilter::Matches( const JtagDecodedFrame& decoded_frame )
+{
+    if( !mConfig.mEnabled )
+        return true;
+
+    const Frame& frame = decoded_frame.mFrame;
+
+    bool store;
+    if( frame.mType == JTAG_SUSPENDED_FRAME )
+    {
+        store = true;
+    }
+    else if( frame.mType == JTAG_REPEATED_SCANS_FRAME )
+    {
+        // the repeated scans are the last ones; every repeat is the same as the first
+        store = false;
+        for( size_t scan_idx = 0; scan_idx < frame.mData2 && scan_idx < mRecentScansStored.size(); ++scan_idx )
+            store |= mRecentScansStored[ mRecentScansStored.size() - 1 - scan_idx ];
+    }
+    else
+    {
+        store = MatchesTapFrame( decoded_frame );
+    }
+
+    if( !store )
+        ++mDroppedCount;
+
+    return store;
+}
+
+bool JtagFrameFilter::MatchesTapFrame( const JtagDecodedFrame& decoded_frame )
+{
+    const JtagTAPState state = JtagTAPState( decoded_frame.mFrame.mType );
+    const JtagShiftedData& shifted_data = decoded_frame.mShiftedData;
+
+    bool store = ( ( mConfig.mStates >> state ) & 1 ) != 0;
+
+    if( store && state >= SelectDRScan && state <= UpdateDR && !mConfig.mInstructions.empty() )
+        store = mInstructionKnown &&
+                std::find( mConfig.mInstructions.begin(), mConfig.mInstructions.end(), mInstruction ) != mConfig.mInstructions.end();
+
+    if( store && state == ShiftDR )
+        store = MatchesPatterns( mConfig.mTdiPatterns, shifted_data.mTdiBits, mDrLsbFirst ) &&
+                MatchesPatterns( mConfig.mTdoPatterns, shifted_data.mTdoBits, mDrLsbFirst );
+
+    // follow the instruction, the same way the search index does
+    switch( state )
+    {
+    case TestLogicReset:
+        mInstructionKnown = false;
+        mPendingInstruction.Clear();
+        break;
+    case ShiftIR:
+        mPendingInstruction.Append( shifted_data.mTdiBits );
+        break;
+    case UpdateIR:
+        mInstructionKnown = mPendingInstruction.GetBitCount() > 0;
+        if( mInstructionKnown )
+            mInstruction = JtagBitView( mPendingInstruction, mIrLsbFirst ).GetTailValue();
+        mPendingInstruction.Clear();
+        break;
+    default:
+        break;
+    }
+
+    mScanStored |= store;
+    if( state == UpdateIR || state == UpdateDR )
+    {
+        mRecentScansStored.push_back( mScanStored );
+        if( mRecentScansStored.size() > JtagRepeatDetector::MAX_REPEAT_SCANS )
+            mRecentScansStored.pop_front();
+
+        mScanStored = false;
+    }
+
+    return store;
+}
+
+bool JtagFrameFilter::MatchesPatterns( const std::vector<JtagFramePattern>& patterns, const JtagPackedBits& bits, bool lsb_first )
+{
+    if( patterns.empty() )
+        return true;
+
+    const JtagBitView view( bits, lsb_first );
+    const U64 bit_count = view.GetBitCount();
+
+    for( std::vector<JtagFramePattern>::const_iterator pi( patterns.begin() ); pi != patterns.end(); ++pi )
+    {
+        bool is_match = true;
+        for( size_t word_idx = 0; word_idx < pi->mValue.size() && is_match; ++word_idx )
+        {
+            // bits [64 * word_idx, 64 * word_idx + 64) of the value, counted from the least significant one
+            const U64 low_bit = U64( word_idx ) * 64;
+            const U64 count = bit_count > low_bit ? std::min( bit_count - low_bit, U64( 64 ) ) : 0;
+            const U64 word = view.GetValue( bit_count - low_bit - count, count );
+
+            is_match = ( word & pi->mMask[ word_idx ] ) == pi->mValue[ word_idx ];
+        }
+
+        if( is_match )
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,86 @@
+#ifndef JTAG_FRAME_FILTER_H
+#define JTAG_FRAME_FILTER_H
+
+#include <LogicPublicTypes.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "JtagTapDecoder.h"
+
+// A value to compare a shifted value against, least significant word first. Only the bits set in
+// the mask are compared, and bits past the end of the shifted value read as 0.
+struct JtagFramePattern
+{
+    std::vector<U64> mValue;
+    std::vector<U64> mMask;
+};
+
+// Which frames to store, parsed from clauses separated by ';', e.g. "ir=0x0E,0x0C; tdo=0x1234/0xFFFF; states=Shift-DR,Update-DR":
+//  states=STATE,...         only frames in these TAP states, by their long or short name
+//  ir=IR,...                only DR branch frames made while one of these instructions was loaded
+//  tdi=VALUE[/MASK],...     only Shift-DR frames with a TDI value matching one of these
+//  tdo=VALUE[/MASK],...     only Shift-DR frames with a TDO value matching one of these
+// Values can be wider than 64 bits when written in hex. An empty string stores everything.
+struct JtagFrameFilterConfig
+{
+    JtagFrameFilterConfig();
+
+    // returns false if the config can't be parsed
+    bool Parse( const std::string& config );
+
+    bool mEnabled;
+    U16 mStates; // one bit per TAP state
+    std::vector<U64> mInstructions;
+    std::vector<JtagFramePattern> mTdiPatterns;
+    std::vector<JtagFramePattern> mTdoPatterns;
+};
+
+// Decides which frames go into the results, as they come out of the repeat detection. Every frame has to
+// go through here in order, so the loaded instruction is known even when the IR scans themselves aren't stored.
+// A JTAG_REPEATED_SCANS_FRAME is stored if any frame of the scans it repeats was, and JTAG_SUSPENDED_FRAMEs
+// are always stored.
+class JtagFrameFilter
+{
+  public:
+    JtagFrameFilter();
+
+    void Init( const JtagFrameFilterConfig& config, bool ir_lsb_first, bool dr_lsb_first );
+
+    bool IsEnabled() const
+    {
+        return mConfig.mEnabled;
+    }
+
+    // false for frames that are only counted
+    bool Matches( const JtagDecodedFrame& decoded_frame );
+
+    U64 GetDroppedCount() const
+    {
+        return mDroppedCount;
+    }
+
+  protected:
+    bool MatchesTapFrame( const JtagDecodedFrame& decoded_frame );
+
+    // a word at a time from the packed bits; true without patterns
+    static bool MatchesPatterns( const std::vector<JtagFramePattern>& patterns, const JtagPackedBits& bits, bool lsb_first );
+
+    JtagFrameFilterConfig mConfig;
+    bool mIrLsbFirst;
+    bool mDrLsbFirst;
+
+    // the instruction being shifted in, and the one loaded by the last Update-IR
+    JtagPackedBits mPendingInstruction;
+    bool mInstructionKnown;
+    U64 mInstruction;
+
+    // whether a frame of the open scan was stored, and the same for the last scans, the newest at the back
+    bool mScanStored;
+    std::deque<bool> mRecentScansStored;
+
+    U64 mDroppedCount;
+};
+
+#endif // JTAG_FRAME_FILTER_H
@@ -0,0 +1,118 @@
+#include <algorithm>
+
+#include "JtagFrameSummary.h"
+
+JtagFrameSummary::JtagFrameSummary()
+    : mFirstFrame( 0 ), mFrameCount( 0 ), mStartingSampleInclusive( 0 ), mEndingSampleInclusive( 0 ), mShiftBitCount( 0 ), mScanCount( 0 )
+{
+    for( int state_cnt = 0; state_cnt < NUM_TAP_STATES; ++state_cnt )
+        mStateSampleCount[ state_cnt ] = 0;
+}
+
+void JtagFrameSummary::AddFrame( const Frame& frame, U64 shift_bit_count )
+{
+    if( mFrameCount == 0 )
+        mStartingSampleInclusive = frame.mStartingSampleInclusive;
+
+    ++mFrameCount;
+    mEndingSampleInclusive = frame.mEndingSampleInclusive;
+
+    if( frame.mType == ShiftIR || frame.mType == ShiftDR )
+    {
+        mShiftBitCount += shift_bit_count;
+        ++mScanCount;
+    }
+
+    if( frame.mType < NUM_TAP_STATES && frame.mEndingSampleInclusive >= frame.mStartingSampleInclusive )
+        mStateSampleCount[ frame.mType ] += frame.mEndingSampleInclusive - frame.mStartingSampleInclusive + 1;
+}
+
+void JtagFrameSummary::Merge( const JtagFrameSummary& other )
+{
+    if( other.mFrameCount == 0 )
+        return;
+
+    if( mFrameCount == 0 )
+    {
+        *this = other;
+        return;
+    }
+
+    mFrameCount += other.mFrameCount;
+    mEndingSampleInclusive = other.mEndingSampleInclusive;
+    mShiftBitCount += other.mShiftBitCount;
+    mScanCount += other.mScanCount;
+
+    for( int state_cnt = 0; state_cnt < NUM_TAP_STATES; ++state_cnt )
+        mStateSampleCount[ state_cnt ] += other.mStateSampleCount[ state_cnt ];
+}
+
+JtagTAPState JtagFrameSummary::GetDominantState() const
+{
+    int dominant_state = 0;
+    for( int state_cnt = 1; state_cnt < NUM_TAP_STATES; ++state_cnt )
+        if( mStateSampleCount[ state_cnt ] > mStateSampleCount[ dominant_state ] )
+            dominant_state = state_cnt;
+
+    return JtagTAPState( dominant_state );
+}
+
+void JtagFrameSummaryPyramid::AddFrame( U64 frame_index, const Frame& frame, U64 shift_bit_count )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    U64 frames_per_node = FRAMES_PER_LEAF;
+    for( size_t level = 0;; ++level, frames_per_node *= FANOUT )
+    {
+        if( level == mLevels.size() )
+        {
+            mLevels.push_back( std::vector<JtagFrameSummary>() );
+
+            // a new top level starts with everything the level below has seen so far
+            if( level > 0 )
+                mLevels[ level ].push_back( mLevels[ level - 1 ].front() );
+        }
+
+        std::vector<JtagFrameSummary>& nodes = mLevels[ level ];
+
+        if( nodes.empty() || nodes.back().mFrameCount == frames_per_node )
+        {
+            nodes.push_back( JtagFrameSummary() );
+            nodes.back().mFirstFrame = frame_index;
+        }
+
+        nodes.back().AddFrame( frame, shift_bit_count );
+
+        // one node covers all frames, no need to go any coarser
+        if( nodes.size() == 1 )
+            break;
+    }
+}
+
+void JtagFrameSummaryPyramid::GetSummaries( U64 first_frame, U64 last_frame, size_t max_nodes, std::vector<JtagFrameSummary>& summaries )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    summaries.clear();
+
+    if( mLevels.empty() || last_frame < first_frame )
+        return;
+
+    U64 frames_per_node = FRAMES_PER_LEAF;
+    for( size_t level = 0; level < mLevels.size(); ++level, frames_per_node *= FANOUT )
+    {
+        const std::vector<JtagFrameSummary>& nodes = mLevels[ level ];
+
+        const U64 first_node = first_frame / frames_per_node;
+        const U64 last_node = std::min<U64>( last_frame / frames_per_node, nodes.size() - 1 );
+
+        // the top level is used whatever its size
+        if( last_node - first_node + 1 > max_nodes && level + 1 < mLevels.size() )
+            continue;
+
+        if( first_node <= last_node )
+            summaries.assign( nodes.begin() + first_node, nodes.begin() + last_node + 1 );
+
+        return;
+    }
+}
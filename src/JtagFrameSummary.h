@@ -0,0 +1,56 @@
+#ifndef JTAG_FRAME_SUMMARY_H
+#define JTAG_FRAME_SUMMARY_H
+
+#include <AnalyzerResults.h>
+
+#include <mutex>
+#include <vector>
+
+#include "JtagTypes.h"
+
+// Summary of a range of consecutive frames, for drawing zoomed out views without
+// going through the individual frames
+struct JtagFrameSummary
+{
+    JtagFrameSummary();
+
+    void AddFrame( const Frame& frame, U64 shift_bit_count );
+    void Merge( const JtagFrameSummary& other );
+
+    // the TAP state the most samples were spent in
+    JtagTAPState GetDominantState() const;
+
+    U64 mFirstFrame;
+    U64 mFrameCount;
+
+    U64 mStartingSampleInclusive;
+    U64 mEndingSampleInclusive;
+
+    U64 mShiftBitCount; // TDI/TDO bits shifted in Shift-IR and Shift-DR
+    U64 mScanCount;     // Shift-IR and Shift-DR frames
+
+    U64 mStateSampleCount[ NUM_TAP_STATES ];
+};
+
+// Pyramid of frame summaries. Level 0 summarizes FRAMES_PER_LEAF frames per node and every
+// level above combines FANOUT nodes of the level below, up to a single node for all frames.
+class JtagFrameSummaryPyramid
+{
+  public:
+    // frames must be added in order
+    void AddFrame( U64 frame_index, const Frame& frame, U64 shift_bit_count );
+
+    // The summaries of the finest level that covers the frames with at most max_nodes nodes.
+    // Nodes are aligned to the pyramid, so the first and last one can reach outside the frame range.
+    void GetSummaries( U64 first_frame, U64 last_frame, size_t max_nodes, std::vector<JtagFrameSummary>& summaries );
+
+  protected:
+    static const U64 FRAMES_PER_LEAF = 64;
+    static const U64 FANOUT = 16;
+
+    std::vector<std::vector<JtagFrameSummary> > mLevels;
+
+    std::mutex mMutex;
+};
+
+#endif // JTAG_FRAME_SUMMARY_H
@@ -0,0 +1,18 @@
+#include "JtagInstrumentation.h"
+
+#ifdef JTAG_INSTRUMENTATION
+
+JtagInstrumentation::JtagInstrumentation()
+{
+    for( int counter = 0; counter < NUM_JTAG_COUNTERS; ++counter )
+        mCounters[ counter ] = 0;
+}
+
+const char* JtagInstrumentation::GetName( JtagCounter counter )
+{
+    const char* names[ NUM_JTAG_COUNTERS ] = { "TckEdges", "FramesClosed", "Markers", "Commits", "DecodeNs", "FormatNs" };
+
+    return names[ counter ];
+}
+
+#endif // JTAG_INSTRUMENTATION
@@ -0,0 +1,78 @@
+#ifndef JTAG_INSTRUMENTATION_H
+#define JTAG_INSTRUMENTATION_H
+
+// Counters of where the decode time goes, built with the JTAG_INSTRUMENTATION CMake option.
+// Without it, JTAG_COUNT and JTAG_TIME_SCOPE compile to nothing and their arguments aren't evaluated.
+
+#ifdef JTAG_INSTRUMENTATION
+
+#include <LogicPublicTypes.h>
+
+#include <atomic>
+#include <chrono>
+
+enum JtagCounter
+{
+    JtagCounterTckEdges,     // rising edges of TCK decoded
+    JtagCounterFramesClosed, // frames added to the results
+    JtagCounterMarkers,      // markers added to the results
+    JtagCounterCommits,      // CommitResults calls
+    JtagCounterDecodeNs,     // time spent decoding clocks into frames and results
+    JtagCounterFormatNs,     // time spent making bubble, tabular and export text
+
+    NUM_JTAG_COUNTERS
+};
+
+class JtagInstrumentation
+{
+  public:
+    JtagInstrumentation();
+
+    void Add( JtagCounter counter, U64 amount )
+    {
+        mCounters[ counter ].fetch_add( amount, std::memory_order_relaxed );
+    }
+
+    U64 Get( JtagCounter counter ) const
+    {
+        return mCounters[ counter ].load( std::memory_order_relaxed );
+    }
+
+    static const char* GetName( JtagCounter counter );
+
+  protected:
+    std::atomic<U64> mCounters[ NUM_JTAG_COUNTERS ];
+};
+
+// adds the time until it goes out of scope to a counter
+class JtagScopedTimer
+{
+  public:
+    JtagScopedTimer( JtagInstrumentation& instrumentation, JtagCounter counter )
+        : mInstrumentation( instrumentation ), mCounter( counter ), mStart( std::chrono::steady_clock::now() )
+    {
+    }
+
+    ~JtagScopedTimer()
+    {
+        const std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - mStart;
+        mInstrumentation.Add( mCounter, U64( std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count() ) );
+    }
+
+  protected:
+    JtagInstrumentation& mInstrumentation;
+    JtagCounter mCounter;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+#define JTAG_COUNT( instrumentation, counter, amount ) ( instrumentation ).Add( counter, amount )
+#define JTAG_TIME_SCOPE( instrumentation, counter ) JtagScopedTimer jtag_scoped_timer( instrumentation, counter )
+
+#else
+
+#define JTAG_COUNT( instrumentation, counter, amount ) ( ( void )0 )
+#define JTAG_TIME_SCOPE( instrumentation, counter ) ( ( void )0 )
+
+#endif // JTAG_INSTRUMENTATION
+
+#endif // JTAG_INSTRUMENTATION_H
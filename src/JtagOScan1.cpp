@@ -0,0 +1,50 @@
+#include "JtagOScan1.h"
+
+JtagOScan1Demux::JtagOScan1Demux()
+{
+    Init();
+}
+
+void JtagOScan1Demux::Init()
+{
+    mOnline = true;
+    mSkipBits = 0;
+    mPhase = 0;
+
+    mClock.mSampleNumber = 0;
+    mClock.mFallingSampleNumber = 0;
+    mClock.mTmsSampleNumber = 0;
+    mClock.mTdiSampleNumber = 0;
+    mClock.mTdoSampleNumber = 0;
+    mClock.mSetupMargin = JTAG_NO_MARGIN_VIOLATION;
+    mClock.mHoldMargin = JTAG_NO_MARGIN_VIOLATION;
+    mClock.mTms = BIT_LOW;
+    mClock.mTdi = BIT_LOW;
+    mClock.mTdo = BIT_LOW;
+    mClock.mFlags = 0;
+}
+
+void JtagOScan1Demux::AddEscape( U32 toggle_count, U64 sample_number, size_t clock_index, std::vector<JtagResetEvent>& resets )
+{
+    mPhase = 0;
+
+    if( toggle_count >= 8 )
+    {
+        JtagResetEvent reset;
+        reset.mClockIndex = clock_index;
+        reset.mSampleNumber = sample_number;
+        reset.mEndingSampleNumber = sample_number;
+        reset.mMode = DebugPortJtag;
+        reset.mClockCount = 0;
+        resets.push_back( reset );
+    }
+    else if( toggle_count >= 6 )
+    {
+        mOnline = true;
+        mSkipBits = ACTIVATION_PACKET_BITS;
+    }
+    else if( toggle_count >= 4 )
+    {
+        mOnline = false;
+    }
+}
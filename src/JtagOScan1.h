@@ -0,0 +1,75 @@
+#ifndef JTAG_OSCAN1_H
+#define JTAG_OSCAN1_H
+
+#include <vector>
+
+#include "JtagTapDecoder.h"
+
+// Turns the TMSC bits of a cJTAG (IEEE 1149.7) OScan1 link back into 4-wire TAP clocks. Every TAP clock
+// takes three TCKC clocks, carrying nTDI, TMS and TDO in that order. Escapes, TMSC toggling while TCKC is
+// high, aren't data bits:
+//  2-3 toggles  custom escape, ignored
+//  4-5 toggles  deselection, the link is offline until the next selection
+//  6-7 toggles  selection, followed by the 12 bit online activation packet (OAC, EC and CP)
+//  8+ toggles   reset, the TAP controller goes to Test-Logic-Reset
+// Any escape starts the next bit triplet over.
+class JtagOScan1Demux
+{
+  public:
+    JtagOScan1Demux();
+
+    // the link is taken to be online in OScan1 at the start of the capture
+    void Init();
+
+    // a TMSC bit sampled on a TCKC rising edge, and the TCKC falling edge before it (0 if not seen)
+    void AddBit( U8 tmsc, U64 rising_sample, U64 falling_sample, std::vector<JtagClockSample>& clocks )
+    {
+        if( !mOnline )
+            return;
+
+        if( mSkipBits != 0 )
+        {
+            --mSkipBits;
+            return;
+        }
+
+        switch( mPhase )
+        {
+        case 0:
+            mClock.mTdi = tmsc == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+            mClock.mTdiSampleNumber = rising_sample;
+            mPhase = 1;
+            break;
+        case 1:
+            // the TAP controller moves on this bit
+            mClock.mSampleNumber = rising_sample;
+            mClock.mFallingSampleNumber = falling_sample;
+            mClock.mTmsSampleNumber = rising_sample;
+            mClock.mTms = tmsc;
+            mPhase = 2;
+            break;
+        default:
+            mClock.mTdo = tmsc;
+            mClock.mTdoSampleNumber = rising_sample;
+            clocks.push_back( mClock );
+            mPhase = 0;
+            break;
+        }
+    }
+
+    // TMSC toggled toggle_count (at least 2) times while TCKC was high, up to the TCKC falling edge at sample_number
+    void AddEscape( U32 toggle_count, U64 sample_number, size_t clock_index, std::vector<JtagResetEvent>& resets );
+
+  protected:
+    // the bits of the online activation packet after a selection escape
+    static const U32 ACTIVATION_PACKET_BITS = 12;
+
+    bool mOnline;
+    U32 mSkipBits;
+
+    // the next bit of the triplet: 0 nTDI, 1 TMS, 2 TDO
+    U32 mPhase;
+    JtagClockSample mClock;
+};
+
+#endif // JTAG_OSCAN1_H
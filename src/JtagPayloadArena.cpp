@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <cstring>
+
+#include "JtagPayloadArena.h"
+
+// the spill file can grow past what a long can address
+static bool SeekSpillFile( FILE* file, U64 offset )
+{
+#ifdef _WIN32
+    return _fseeki64( file, S64( offset ), SEEK_SET ) == 0;
+#else
+    return fseeko( file, off_t( offset ), SEEK_SET ) == 0;
+#endif
+}
+
+static std::shared_ptr<U64> AllocateWords( size_t word_count )
+{
+    return std::shared_ptr<U64>( new U64[ word_count ], std::default_delete<U64[]>() );
+}
+
+JtagPayloadArena::JtagPayloadArena()
+    : mAllocatedWords( 0 ),
+      mMaxResidentBytes( 0 ),
+      mResidentBytes( 0 ),
+      mSpillFile( NULL ),
+      mSpillFileSize( 0 ),
+      mSpillFailed( false ),
+      mStreaming( false ),
+      mEvictedBytes( 0 ),
+      mCompress( false ),
+      mPayloadBytes( 0 ),
+      mStoredBytes( 0 )
+{
+}
+
+JtagPayloadArena::~JtagPayloadArena()
+{
+    // the temporary file is removed when it's closed
+    if( mSpillFile != NULL )
+        fclose( mSpillFile );
+}
+
+void JtagPayloadArena::SetMemoryLimit( U64 max_resident_bytes )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    mMaxResidentBytes = max_resident_bytes;
+}
+
+void JtagPayloadArena::SetCompression( bool compress )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    mCompress = compress;
+}
+
+void JtagPayloadArena::SetStreaming( bool streaming )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    mStreaming = streaming;
+}
+
+// mixes every word into the hash, so payloads that differ anywhere get different hashes
+static U64 HashWords( const U64* words, size_t word_count )
+{
+    U64 hash = 0xCBF29CE484222325ULL;
+    for( size_t word_idx = 0; word_idx < word_count; ++word_idx )
+    {
+        hash ^= words[ word_idx ];
+        hash *= 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+U64 JtagPayloadArena::Append( const JtagPackedBits& bits )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    Encode( bits );
+    mPayloadBytes += ( 1 + ( bits.GetBitCount() + 63 ) / 64 ) * sizeof( U64 );
+
+    if( !mCompress )
+    {
+        mStoredBytes += mEncoded.size() * sizeof( U64 );
+        return Store( &mEncoded[ 0 ], mEncoded.size() );
+    }
+
+    const U64 hash = HashWords( &mEncoded[ 0 ], mEncoded.size() );
+
+    U64 offset;
+    if( FindDuplicate( hash, offset ) )
+        return offset;
+
+    offset = Store( &mEncoded[ 0 ], mEncoded.size() );
+    mStoredBytes += mEncoded.size() * sizeof( U64 );
+
+    if( mRecentPayloads.size() >= MAX_DEDUP_ENTRIES )
+        mRecentPayloads.clear();
+    mRecentPayloads[ hash ] = offset;
+
+    return offset;
+}
+
+void JtagPayloadArena::Encode( const JtagPackedBits& bits )
+{
+    const U64 bit_count = bits.GetBitCount();
+    const size_t word_count = size_t( ( bit_count + 63 ) / 64 );
+    const U64* words = bits.GetWords();
+
+    mEncoded.clear();
+    mEncoded.push_back( bit_count );
+
+    if( mCompress && word_count > 0 )
+    {
+        // the bits past the end of the last word are always 0
+        const U64 last_word_mask = ( bit_count % 64 == 0 ) ? ~0ULL : ( 1ULL << ( bit_count % 64 ) ) - 1;
+
+        bool all_zeros = true;
+        bool all_ones = true;
+        size_t run_count = 1;
+
+        for( size_t word_idx = 0; word_idx < word_count; ++word_idx )
+        {
+            all_zeros = all_zeros && words[ word_idx ] == 0;
+            all_ones = all_ones && words[ word_idx ] == ( word_idx + 1 == word_count ? last_word_mask : ~0ULL );
+
+            if( word_idx > 0 && words[ word_idx ] != words[ word_idx - 1 ] )
+                ++run_count;
+        }
+
+        if( all_zeros || all_ones )
+        {
+            mEncoded[ 0 ] |= U64( all_zeros ? ConstantZeros : ConstantOnes ) << ENCODING_SHIFT;
+            return;
+        }
+
+        if( 1 + 2 * run_count < word_count )
+        {
+            mEncoded[ 0 ] |= U64( RunLengthPayload ) << ENCODING_SHIFT;
+            mEncoded.push_back( run_count );
+
+            for( size_t word_idx = 0; word_idx < word_count; ++word_idx )
+            {
+                if( word_idx == 0 || words[ word_idx ] != words[ word_idx - 1 ] )
+                {
+                    mEncoded.push_back( words[ word_idx ] );
+                    mEncoded.push_back( 0 );
+                }
+
+                ++mEncoded.back();
+            }
+
+            return;
+        }
+    }
+
+    mEncoded.insert( mEncoded.end(), words, words + word_count );
+}
+
+size_t JtagPayloadArena::GetEncodedWordCount( const U64* encoded )
+{
+    switch( PayloadEncoding( encoded[ 0 ] >> ENCODING_SHIFT ) )
+    {
+    case ConstantZeros:
+    case ConstantOnes:
+        return 1;
+    case RunLengthPayload:
+        return size_t( 2 + 2 * encoded[ 1 ] );
+    default:
+        return size_t( 1 + ( ( encoded[ 0 ] & BIT_COUNT_MASK ) + 63 ) / 64 );
+    }
+}
+
+void JtagPayloadArena::Decode( const U64* encoded, U64* words )
+{
+    const U64 bit_count = encoded[ 0 ] & BIT_COUNT_MASK;
+    const size_t word_count = size_t( ( bit_count + 63 ) / 64 );
+
+    switch( PayloadEncoding( encoded[ 0 ] >> ENCODING_SHIFT ) )
+    {
+    case ConstantZeros:
+        std::fill( words, words + word_count, 0ULL );
+        break;
+    case ConstantOnes:
+        std::fill( words, words + word_count, ~0ULL );
+        if( bit_count % 64 != 0 )
+            words[ word_count - 1 ] = ( 1ULL << ( bit_count % 64 ) ) - 1;
+        break;
+    case RunLengthPayload:
+    {
+        const U64* run = encoded + 2;
+        for( U64 run_idx = 0; run_idx < encoded[ 1 ]; ++run_idx, run += 2 )
+            words = std::fill_n( words, size_t( run[ 1 ] ), run[ 0 ] );
+        break;
+    }
+    default:
+        std::copy( encoded + 1, encoded + 1 + word_count, words );
+        break;
+    }
+}
+
+bool JtagPayloadArena::FindDuplicate( U64 hash, U64& offset )
+{
+    std::unordered_map<U64, U64>::const_iterator pi( mRecentPayloads.find( hash ) );
+    if( pi == mRecentPayloads.end() )
+        return false;
+
+    // not worth reading a spilled slab back for
+    const size_t slab_index = size_t( pi->second >> 32 );
+    const Slab& slab = mSlabs[ slab_index ];
+    if( slab.mWords == NULL )
+        return false;
+
+    // with streaming, only the newest slab, so payloads are dropped in the order they were appended
+    if( mStreaming && slab_index + 1 != mSlabs.size() )
+        return false;
+
+    const U64* stored = slab.mWords.get() + size_t( pi->second & 0xFFFFFFFF );
+    if( GetEncodedWordCount( stored ) != mEncoded.size() || !std::equal( mEncoded.begin(), mEncoded.end(), stored ) )
+        return false;
+
+    offset = pi->second;
+    return true;
+}
+
+U64 JtagPayloadArena::Store( const U64* words, size_t word_count )
+{
+    if( mSlabs.empty() || mSlabs.back().mCapacity - mSlabs.back().mUsed < word_count )
+    {
+        if( !mSlabs.empty() )
+            SealSlab( mSlabs.size() - 1 );
+
+        Slab slab;
+        slab.mCapacity = word_count > SLAB_WORDS ? word_count : SLAB_WORDS;
+        slab.mWords = AllocateWords( slab.mCapacity );
+        slab.mResidentWords = slab.mCapacity;
+        slab.mUsed = 0;
+        slab.mSpilled = false;
+        slab.mFileOffset = 0;
+
+        mAllocatedWords += slab.mCapacity;
+        mResidentBytes += slab.mResidentWords * sizeof( U64 );
+        mSlabs.push_back( slab );
+
+        EnforceMemoryLimit();
+    }
+
+    Slab& slab = mSlabs.back();
+    const U64 offset = MakeOffset( mSlabs.size() - 1, slab.mUsed );
+
+    memcpy( slab.mWords.get() + slab.mUsed, words, word_count * sizeof( U64 ) );
+    slab.mUsed += word_count;
+
+    return offset;
+}
+
+void JtagPayloadArena::SealSlab( size_t slab_index )
+{
+    if( mMaxResidentBytes == 0 )
+        return;
+
+    // the slabs are never used again, so mResidentSlabs stays in the order they were sealed
+    if( mStreaming )
+    {
+        mResidentSlabs.push_front( slab_index );
+        mSlabs[ slab_index ].mResidentPos = mResidentSlabs.begin();
+        return;
+    }
+
+    if( mSpillFile == NULL )
+    {
+        mSpillFile = tmpfile();
+
+        // no place to spill to, everything stays in memory
+        if( mSpillFile == NULL )
+        {
+            mMaxResidentBytes = 0;
+            mSpillFailed = true;
+            return;
+        }
+    }
+
+    Slab& slab = mSlabs[ slab_index ];
+
+    // the disk is full or the file is broken; the slabs spilled so far can still be read back, the rest stays in memory
+    if( !SeekSpillFile( mSpillFile, mSpillFileSize ) || fwrite( slab.mWords.get(), sizeof( U64 ), slab.mUsed, mSpillFile ) != slab.mUsed )
+    {
+        mMaxResidentBytes = 0;
+        mSpillFailed = true;
+        return;
+    }
+
+    slab.mSpilled = true;
+    slab.mFileOffset = mSpillFileSize;
+    mSpillFileSize += slab.mUsed * sizeof( U64 );
+
+    mResidentSlabs.push_front( slab_index );
+    slab.mResidentPos = mResidentSlabs.begin();
+}
+
+void JtagPayloadArena::EnforceMemoryLimit()
+{
+    if( mMaxResidentBytes == 0 )
+        return;
+
+    // the most recently used slab always stays
+    while( mResidentBytes > mMaxResidentBytes && mResidentSlabs.size() > 1 )
+    {
+        Slab& slab = mSlabs[ mResidentSlabs.back() ];
+        mResidentSlabs.pop_back();
+
+        // payloads still being formatted keep their memory until they are done
+        slab.mWords.reset();
+        mResidentBytes -= slab.mResidentWords * sizeof( U64 );
+        if( !slab.mSpilled )
+            mEvictedBytes += slab.mResidentWords * sizeof( U64 );
+        slab.mResidentWords = 0;
+    }
+}
+
+const std::shared_ptr<U64>& JtagPayloadArena::LoadSlab( size_t slab_index )
+{
+    Slab& slab = mSlabs[ slab_index ];
+
+    if( slab.mWords != NULL )
+    {
+        if( slab.mSpilled )
+            mResidentSlabs.splice( mResidentSlabs.begin(), mResidentSlabs, slab.mResidentPos );
+
+        return slab.mWords;
+    }
+
+    // evicted
+    if( !slab.mSpilled )
+        return slab.mWords;
+
+    slab.mWords = AllocateWords( slab.mUsed );
+    slab.mResidentWords = slab.mUsed;
+    mResidentBytes += slab.mResidentWords * sizeof( U64 );
+
+    if( !SeekSpillFile( mSpillFile, slab.mFileOffset ) || fread( slab.mWords.get(), sizeof( U64 ), slab.mUsed, mSpillFile ) != slab.mUsed )
+        memset( slab.mWords.get(), 0, slab.mUsed * sizeof( U64 ) );
+
+    mResidentSlabs.push_front( slab_index );
+    slab.mResidentPos = mResidentSlabs.begin();
+
+    EnforceMemoryLimit();
+
+    return slab.mWords;
+}
+
+JtagPayload JtagPayloadArena::GetPayload( U64 offset, bool lsb_first )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    JtagPayload payload;
+
+    const std::shared_ptr<U64>& slab_words = LoadSlab( size_t( offset >> 32 ) );
+    if( slab_words == NULL )
+    {
+        payload.mEvicted = true;
+        return payload;
+    }
+
+    const U64* encoded = slab_words.get() + size_t( offset & 0xFFFFFFFF );
+    const U64 bit_count = encoded[ 0 ] & BIT_COUNT_MASK;
+
+    if( PayloadEncoding( encoded[ 0 ] >> ENCODING_SHIFT ) == RawPayload )
+    {
+        payload.mWords = slab_words;
+        payload.mBits = JtagBitView( encoded + 1, bit_count, lsb_first );
+    }
+    else
+    {
+        // decoded into memory of its own
+        std::shared_ptr<U64> words = AllocateWords( std::max<size_t>( 1, size_t( ( bit_count + 63 ) / 64 ) ) );
+        Decode( encoded, words.get() );
+
+        payload.mWords = words;
+        payload.mBits = JtagBitView( words.get(), bit_count, lsb_first );
+    }
+
+    return payload;
+}
+
+U64 JtagPayloadArena::GetAllocatedBytes()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    return mAllocatedWords * sizeof( U64 );
+}
+
+U64 JtagPayloadArena::GetResidentBytes()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    return mResidentBytes;
+}
+
+U64 JtagPayloadArena::GetPayloadBytes()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    return mPayloadBytes;
+}
+
+U64 JtagPayloadArena::GetStoredBytes()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    return mStoredBytes;
+}
+
+U64 JtagPayloadArena::GetEvictedBytes()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    return mEvictedBytes;
+}
+
+bool JtagPayloadArena::HasSpillFailed()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    return mSpillFailed;
+}
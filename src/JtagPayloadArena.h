@@ -0,0 +1,161 @@
+#ifndef JTAG_PAYLOAD_ARENA_H
+#define JTAG_PAYLOAD_ARENA_H
+
+#include <LogicPublicTypes.h>
+
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "JtagTypes.h"
+
+// A payload read from the arena. Holds on to the memory of its slab, or of its decoded bits, so
+// the bits stay valid even if the arena spills the slab to disk in the meantime.
+class JtagPayload
+{
+  public:
+    JtagPayload() : mBits( NULL, 0, false ), mEvicted( false )
+    {
+    }
+
+    const JtagBitView& GetBits() const
+    {
+        return mBits;
+    }
+
+    // the bits were dropped by a streaming arena, and read as empty
+    bool IsEvicted() const
+    {
+        return mEvicted;
+    }
+
+  protected:
+    friend class JtagPayloadArena;
+
+    std::shared_ptr<const U64> mWords;
+    JtagBitView mBits;
+    bool mEvicted;
+};
+
+// Append-only storage for the packed TDI/TDO bits of the shift frames. Payloads are copied into
+// large slabs, so a frame doesn't need heap allocations of its own, and everything is freed
+// slab by slab when the results go away.
+// With a memory limit, full slabs are written to a temporary file and only the most recently
+// used ones stay in memory. Slabs that were dropped are read back when a payload in them is needed.
+// With streaming, nothing goes to disk: over the memory limit, the oldest slabs are dropped for good,
+// so the arena holds a window of the most recent payloads however long the capture runs.
+// With compression, constant and repetitive payloads are run-length encoded, and a payload that
+// is the same as a recent one refers to that one. They are decoded when they are read.
+class JtagPayloadArena
+{
+  public:
+    JtagPayloadArena();
+    ~JtagPayloadArena();
+
+    // 0 keeps everything in memory
+    void SetMemoryLimit( U64 max_resident_bytes );
+    void SetCompression( bool compress );
+    void SetStreaming( bool streaming );
+
+    // copies the bits and returns their offset
+    U64 Append( const JtagPackedBits& bits );
+
+    JtagPayload GetPayload( U64 offset, bool lsb_first );
+
+    U64 GetAllocatedBytes();
+    U64 GetResidentBytes();
+
+    // bytes of the payloads as they were appended, and as they were stored
+    U64 GetPayloadBytes();
+    U64 GetStoredBytes();
+
+    // bytes of the slabs dropped with streaming
+    U64 GetEvictedBytes();
+
+    // the temporary file couldn't be created or written, so the memory limit was given up
+    bool HasSpillFailed();
+
+  protected:
+    // payloads that don't fit in a slab get a slab of their own
+    static const size_t SLAB_WORDS = 1 << 16;
+
+    // a payload starts with its bit count, with the encoding in the top byte
+    enum PayloadEncoding
+    {
+        RawPayload,       // the packed bits follow
+        ConstantZeros,    // nothing follows
+        ConstantOnes,     // nothing follows
+        RunLengthPayload, // the number of runs follows, then a word and its repeat count per run
+    };
+
+    static const int ENCODING_SHIFT = 56;
+    static const U64 BIT_COUNT_MASK = ( 1ULL << ENCODING_SHIFT ) - 1;
+
+    // recent payloads by content hash, for finding duplicates; cleared when it gets this big
+    static const size_t MAX_DEDUP_ENTRIES = 1 << 16;
+
+    // fills mEncoded with the payload as it will be stored
+    void Encode( const JtagPackedBits& bits );
+    static size_t GetEncodedWordCount( const U64* encoded );
+    static void Decode( const U64* encoded, U64* words );
+
+    // the offset of an earlier payload that is the same as mEncoded, or false
+    bool FindDuplicate( U64 hash, U64& offset );
+
+    U64 Store( const U64* words, size_t word_count );
+
+    struct Slab
+    {
+        std::shared_ptr<U64> mWords; // NULL while the slab is only on disk
+        size_t mResidentWords;
+        size_t mCapacity;
+        size_t mUsed;
+
+        bool mSpilled; // written to the temporary file
+        U64 mFileOffset;
+        std::list<size_t>::iterator mResidentPos;
+    };
+
+    // offsets are the slab index in the upper, and the word in the slab in the lower 32 bits
+    static U64 MakeOffset( size_t slab_index, size_t word_index )
+    {
+        return ( U64( slab_index ) << 32 ) | word_index;
+    }
+
+    // writes the full slab to the temporary file, and drops slabs from memory while over the limit.
+    // With streaming, the slabs are dropped oldest first, and nothing is written.
+    void SealSlab( size_t slab_index );
+    void EnforceMemoryLimit();
+
+    const std::shared_ptr<U64>& LoadSlab( size_t slab_index );
+
+    std::vector<Slab> mSlabs;
+    U64 mAllocatedWords;
+
+    U64 mMaxResidentBytes;
+    U64 mResidentBytes;
+
+    // sealed slabs in memory, most recently used first
+    std::list<size_t> mResidentSlabs;
+
+    FILE* mSpillFile;
+    U64 mSpillFileSize;
+    bool mSpillFailed;
+
+    bool mStreaming;
+    U64 mEvictedBytes;
+
+    bool mCompress;
+    std::vector<U64> mEncoded;
+    std::unordered_map<U64, U64> mRecentPayloads;
+
+    U64 mPayloadBytes;
+    U64 mStoredBytes;
+
+    std::mutex mMutex;
+};
+
+#endif // JTAG_PAYLOAD_ARENA_H
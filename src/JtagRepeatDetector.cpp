@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <iterator>
+
+#include "JtagRepeatDetector.h"
+
+JtagRepeatDetector::JtagRepeatDetector()
+    : mEnabled( false ),
+      mRepeating( false ),
+      mRepeatCount( 0 ),
+      mRepeatFlags( 0 ),
+      mRepeatStartingSample( 0 ),
+      mRepeatEndingSample( 0 ),
+      mRepeatNextState( TestLogicReset )
+{
+    mOpenScan.mHash = 0;
+}
+
+void JtagRepeatDetector::Init( bool enabled )
+{
+    mEnabled = enabled;
+
+    mOpenScan.mFrames.clear();
+    mOpenScan.mHash = 0;
+    mHeldScans.clear();
+
+    mRepeating = false;
+    mRepeatScans.clear();
+    mPartialRepeat.clear();
+}
+
+void JtagRepeatDetector::Add( JtagDecodedFrame& decoded_frame, std::vector<JtagDecodedFrame>& ready_frames )
+{
+    if( !mEnabled )
+    {
+        ready_frames.push_back( std::move( decoded_frame ) );
+        return;
+    }
+
+    // nothing repeats across the time out of JTAG mode
+    if( decoded_frame.mFrame.mType == JTAG_SUSPENDED_FRAME )
+    {
+        Flush( ready_frames );
+        ready_frames.push_back( std::move( decoded_frame ) );
+        return;
+    }
+
+    mOpenScan.mHash = HashFrame( mOpenScan.mHash, decoded_frame );
+    mOpenScan.mFrames.push_back( std::move( decoded_frame ) );
+
+    const U8 frame_type = mOpenScan.mFrames.back().mFrame.mType;
+    if( frame_type == UpdateIR || frame_type == UpdateDR )
+    {
+        AddScan( mOpenScan, ready_frames );
+
+        mOpenScan.mFrames.clear();
+        mOpenScan.mHash = 0;
+    }
+}
+
+void JtagRepeatDetector::Flush( std::vector<JtagDecodedFrame>& ready_frames )
+{
+    if( mRepeating )
+        EndRepeat( ready_frames );
+
+    while( !mHeldScans.empty() )
+    {
+        MoveFrames( mHeldScans.front(), ready_frames );
+        mHeldScans.pop_front();
+    }
+
+    MoveFrames( mOpenScan, ready_frames );
+    mOpenScan.mHash = 0;
+}
+
+void JtagRepeatDetector::AddScan( Scan& scan, std::vector<JtagDecodedFrame>& ready_frames )
+{
+    if( mRepeating )
+    {
+        // the next scan of the repeat?
+        if( IsSameScan( scan, mRepeatScans[ mPartialRepeat.size() ] ) )
+        {
+            mPartialRepeat.push_back( std::move( scan ) );
+
+            if( mPartialRepeat.size() == mRepeatScans.size() )
+            {
+                ++mRepeatCount;
+                mRepeatEndingSample = mPartialRepeat.back().mFrames.back().mFrame.mEndingSampleInclusive;
+                mRepeatNextState = mPartialRepeat.back().mFrames.back().mNextState;
+
+                for( std::vector<Scan>::iterator si( mPartialRepeat.begin() ); si != mPartialRepeat.end(); ++si )
+                    AddToRepeat( *si );
+
+                mPartialRepeat.clear();
+            }
+
+            return;
+        }
+
+        EndRepeat( ready_frames );
+    }
+
+    mHeldScans.push_back( std::move( scan ) );
+
+    // do the last scans repeat the ones before them?
+    const size_t num_scans = mHeldScans.size();
+    for( size_t repeat_scans = 1; repeat_scans <= MAX_REPEAT_SCANS && 2 * repeat_scans <= num_scans; ++repeat_scans )
+    {
+        bool is_repeat = true;
+        for( size_t scan_idx = num_scans - repeat_scans; scan_idx < num_scans && is_repeat; ++scan_idx )
+            is_repeat = IsSameScan( mHeldScans[ scan_idx ], mHeldScans[ scan_idx - repeat_scans ] );
+
+        if( !is_repeat )
+            continue;
+
+        // the scans before the first repeat are shown as they are
+        while( mHeldScans.size() > repeat_scans )
+        {
+            MoveFrames( mHeldScans.front(), ready_frames );
+            mHeldScans.pop_front();
+        }
+
+        mRepeating = true;
+        mRepeatCount = 1;
+        mRepeatFlags = 0;
+        mRepeatStartingSample = mHeldScans.front().mFrames.front().mFrame.mStartingSampleInclusive;
+        mRepeatEndingSample = mHeldScans.back().mFrames.back().mFrame.mEndingSampleInclusive;
+        mRepeatNextState = mHeldScans.back().mFrames.back().mNextState;
+
+        mRepeatTiming.Clear();
+        for( std::deque<Scan>::iterator si( mHeldScans.begin() ); si != mHeldScans.end(); ++si )
+            AddToRepeat( *si );
+
+        // the collapsed scans are kept to compare the next ones to
+        mRepeatScans.assign( std::make_move_iterator( mHeldScans.begin() ), std::make_move_iterator( mHeldScans.end() ) );
+        mHeldScans.clear();
+        return;
+    }
+
+    while( mHeldScans.size() > 2 * MAX_REPEAT_SCANS - 1 )
+    {
+        MoveFrames( mHeldScans.front(), ready_frames );
+        mHeldScans.pop_front();
+    }
+}
+
+void JtagRepeatDetector::EndRepeat( std::vector<JtagDecodedFrame>& ready_frames )
+{
+    JtagDecodedFrame repeat_frame;
+    repeat_frame.mFrame.mType = JTAG_REPEATED_SCANS_FRAME;
+    repeat_frame.mFrame.mFlags = mRepeatFlags;
+    repeat_frame.mFrame.mData1 = mRepeatCount;
+    repeat_frame.mFrame.mData2 = mRepeatScans.size();
+    repeat_frame.mFrame.mStartingSampleInclusive = mRepeatStartingSample;
+    repeat_frame.mFrame.mEndingSampleInclusive = mRepeatEndingSample;
+    repeat_frame.mNextState = mRepeatNextState;
+    repeat_frame.mTiming = mRepeatTiming;
+    ready_frames.push_back( std::move( repeat_frame ) );
+
+    // a repeat that was cut short is shown as it is
+    for( std::vector<Scan>::iterator si( mPartialRepeat.begin() ); si != mPartialRepeat.end(); ++si )
+        MoveFrames( *si, ready_frames );
+
+    mPartialRepeat.clear();
+    mRepeatScans.clear();
+    mRepeating = false;
+}
+
+void JtagRepeatDetector::MoveFrames( Scan& scan, std::vector<JtagDecodedFrame>& ready_frames )
+{
+    for( std::vector<JtagDecodedFrame>::iterator dfi( scan.mFrames.begin() ); dfi != scan.mFrames.end(); ++dfi )
+        ready_frames.push_back( std::move( *dfi ) );
+
+    scan.mFrames.clear();
+}
+
+void JtagRepeatDetector::AddToRepeat( const Scan& scan )
+{
+    for( std::vector<JtagDecodedFrame>::const_iterator dfi( scan.mFrames.begin() ); dfi != scan.mFrames.end(); ++dfi )
+    {
+        mRepeatTiming.Merge( dfi->mTiming );
+        mRepeatFlags |= dfi->mFrame.mFlags;
+    }
+}
+
+U64 JtagRepeatDetector::HashFrame( U64 hash, const JtagDecodedFrame& decoded_frame )
+{
+    const JtagPackedBits* payloads[ 2 ] = { &decoded_frame.mShiftedData.mTdiBits, &decoded_frame.mShiftedData.mTdoBits };
+
+    hash = ( hash ^ decoded_frame.mFrame.mType ^ ( U64( decoded_frame.mFrame.mFlags ) << 8 ) ) * 0x100000001B3ULL;
+
+    for( int payload_idx = 0; payload_idx < 2; ++payload_idx )
+    {
+        const JtagPackedBits& bits = *payloads[ payload_idx ];
+        const U64* words = bits.GetWords();
+
+        hash = ( hash ^ bits.GetBitCount() ) * 0x100000001B3ULL;
+        for( U64 word_idx = 0; word_idx < ( bits.GetBitCount() + 63 ) / 64; ++word_idx )
+        {
+            hash = ( hash ^ words[ word_idx ] ) * 0x100000001B3ULL;
+            hash ^= hash >> 29;
+        }
+    }
+
+    return hash;
+}
+
+bool JtagRepeatDetector::IsSameScan( const Scan& scan, const Scan& other_scan )
+{
+    if( scan.mHash != other_scan.mHash || scan.mFrames.size() != other_scan.mFrames.size() )
+        return false;
+
+    // the hash can collide, so the frames are compared as well
+    for( size_t frame_idx = 0; frame_idx < scan.mFrames.size(); ++frame_idx )
+    {
+        const JtagDecodedFrame& decoded_frame = scan.mFrames[ frame_idx ];
+        const JtagDecodedFrame& other_frame = other_scan.mFrames[ frame_idx ];
+
+        if( decoded_frame.mFrame.mType != other_frame.mFrame.mType || decoded_frame.mFrame.mFlags != other_frame.mFrame.mFlags ||
+            !IsSameBits( decoded_frame.mShiftedData.mTdiBits, other_frame.mShiftedData.mTdiBits ) ||
+            !IsSameBits( decoded_frame.mShiftedData.mTdoBits, other_frame.mShiftedData.mTdoBits ) )
+            return false;
+    }
+
+    return true;
+}
+
+bool JtagRepeatDetector::IsSameBits( const JtagPackedBits& bits, const JtagPackedBits& other_bits )
+{
+    // the bits past the end of the last word are always 0
+    const U64 word_count = ( bits.GetBitCount() + 63 ) / 64;
+    return bits.GetBitCount() == other_bits.GetBitCount() && std::equal( bits.GetWords(), bits.GetWords() + word_count, other_bits.GetWords() );
+}
@@ -0,0 +1,66 @@
+#ifndef JTAG_REPEAT_DETECTOR_H
+#define JTAG_REPEAT_DETECTOR_H
+
+#include <deque>
+#include <vector>
+
+#include "JtagTapDecoder.h"
+
+// Collapses scans that repeat the scans right before them, like a probe polling a status register.
+// A scan is the frames up to and including Update-IR or Update-DR, and a repeat can be up to
+// MAX_REPEAT_SCANS scans long. Scans are compared by a hash of their TAP states and TDI/TDO bits, and
+// a matching hash is confirmed by comparing the frames themselves. The first occurrence is kept as it
+// is, the repeats after it become a single JTAG_REPEATED_SCANS_FRAME, with the flags of the frames it replaces.
+class JtagRepeatDetector
+{
+  public:
+    static const size_t MAX_REPEAT_SCANS = 4;
+
+    JtagRepeatDetector();
+
+    // starts over; when disabled, frames are passed on right away
+    void Init( bool enabled );
+
+    // takes a decoded frame, and appends the frames that can be added to the results to ready_frames
+    void Add( JtagDecodedFrame& decoded_frame, std::vector<JtagDecodedFrame>& ready_frames );
+
+    // passes on everything that was held back
+    void Flush( std::vector<JtagDecodedFrame>& ready_frames );
+
+  protected:
+    struct Scan
+    {
+        std::vector<JtagDecodedFrame> mFrames;
+        U64 mHash;
+    };
+
+    void AddScan( Scan& scan, std::vector<JtagDecodedFrame>& ready_frames );
+    void EndRepeat( std::vector<JtagDecodedFrame>& ready_frames );
+    void AddToRepeat( const Scan& scan );
+
+    static void MoveFrames( Scan& scan, std::vector<JtagDecodedFrame>& ready_frames );
+    static U64 HashFrame( U64 hash, const JtagDecodedFrame& decoded_frame );
+    static bool IsSameScan( const Scan& scan, const Scan& other_scan );
+    static bool IsSameBits( const JtagPackedBits& bits, const JtagPackedBits& other_bits );
+
+    bool mEnabled;
+
+    // frames since the last Update-IR/Update-DR
+    Scan mOpenScan;
+
+    // the last scans, up to twice the longest repeat, so the newest ones can be compared to the ones before them
+    std::deque<Scan> mHeldScans;
+
+    // the repeat being collapsed, and the scans it repeats
+    bool mRepeating;
+    std::vector<Scan> mRepeatScans;
+    std::vector<Scan> mPartialRepeat;
+    U64 mRepeatCount;
+    U8 mRepeatFlags;
+    U64 mRepeatStartingSample;
+    U64 mRepeatEndingSample;
+    JtagTckTiming mRepeatTiming; // the clocks of the collapsed scans
+    JtagTAPState mRepeatNextState;
+};
+
+#endif // JTAG_REPEAT_DETECTOR_H
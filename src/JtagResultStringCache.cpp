@@ -0,0 +1,65 @@
+#include "JtagResultStringCache.h"
+
+JtagResultStringCache::JtagResultStringCache( size_t max_entries )
+    : mMaxEntries( max_entries ), mPresentationSettings( 0 ), mHitCount( 0 ), mMissCount( 0 )
+{
+}
+
+U64 JtagResultStringCache::MakeKey( U64 frame_index, StringKind kind, DisplayBase display_base )
+{
+    return ( frame_index << 8 ) | ( U64( kind ) << 4 ) | U64( display_base );
+}
+
+void JtagResultStringCache::Validate( U32 presentation_settings )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    if( presentation_settings == mPresentationSettings )
+        return;
+
+    mEntries.clear();
+    mEntryMap.clear();
+    mPresentationSettings = presentation_settings;
+}
+
+bool JtagResultStringCache::Find( U64 key, std::vector<std::string>& result_strings )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    std::unordered_map<U64, EntryList::iterator>::iterator emi( mEntryMap.find( key ) );
+    if( emi == mEntryMap.end() )
+    {
+        ++mMissCount;
+        return false;
+    }
+
+    // move it to the front of the list
+    mEntries.splice( mEntries.begin(), mEntries, emi->second );
+
+    result_strings = emi->second->mResultStrings;
+    ++mHitCount;
+
+    return true;
+}
+
+void JtagResultStringCache::Insert( U64 key, const std::vector<std::string>& result_strings )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    if( mEntryMap.find( key ) != mEntryMap.end() )
+        return;
+
+    // evict the least recently used entry
+    if( mEntries.size() >= mMaxEntries )
+    {
+        mEntryMap.erase( mEntries.back().mKey );
+        mEntries.pop_back();
+    }
+
+    Entry entry;
+    entry.mKey = key;
+    entry.mResultStrings = result_strings;
+    mEntries.push_front( entry );
+
+    mEntryMap[ key ] = mEntries.begin();
+}
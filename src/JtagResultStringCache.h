@@ -0,0 +1,68 @@
+#ifndef JTAG_RESULT_STRING_CACHE_H
+#define JTAG_RESULT_STRING_CACHE_H
+
+#include <LogicPublicTypes.h>
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bounded LRU cache of formatted bubble and tabular strings, so frames the UI asks for
+// over and over again are only formatted once.
+class JtagResultStringCache
+{
+  public:
+    // what the strings were made for
+    enum StringKind
+    {
+        TdiBubble,
+        TdoBubble,
+        TabularText
+    };
+
+    JtagResultStringCache( size_t max_entries );
+
+    static U64 MakeKey( U64 frame_index, StringKind kind, DisplayBase display_base );
+
+    // drops everything if the strings were made with different presentation settings
+    void Validate( U32 presentation_settings );
+
+    // returns true and copies the strings if they are cached
+    bool Find( U64 key, std::vector<std::string>& result_strings );
+    void Insert( U64 key, const std::vector<std::string>& result_strings );
+
+    U64 GetHitCount() const
+    {
+        return mHitCount;
+    }
+
+    U64 GetMissCount() const
+    {
+        return mMissCount;
+    }
+
+  protected:
+    struct Entry
+    {
+        U64 mKey;
+        std::vector<std::string> mResultStrings;
+    };
+
+    typedef std::list<Entry> EntryList;
+
+    size_t mMaxEntries;
+    U32 mPresentationSettings;
+
+    // most recently used first
+    EntryList mEntries;
+    std::unordered_map<U64, EntryList::iterator> mEntryMap;
+
+    U64 mHitCount;
+    U64 mMissCount;
+
+    std::mutex mMutex;
+};
+
+#endif // JTAG_RESULT_STRING_CACHE_H
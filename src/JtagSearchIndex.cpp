@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "JtagSearchIndex.h"
+#include "JtagRepeatDetector.h"
+
+JtagSearchQuery::JtagSearchQuery() : mMatchInstruction( false ), mInstruction( 0 ), mMatchTdo( false ), mTdo( 0 ), mTdoMask( ~0ULL )
+{
+}
+
+// parses a whole number in C notation (0x.., 0.., decimal)
+static bool ParseNumber( const std::string& str, U64& value )
+{
+    if( str.empty() )
+        return false;
+
+    char* end;
+    value = strtoull( str.c_str(), &end, 0 );
+
+    return *end == '\0';
+}
+
+bool JtagSearchQuery::Parse( const std::string& query )
+{
+    *this = JtagSearchQuery();
+
+    std::string str;
+    for( std::string::const_iterator ci( query.begin() ); ci != query.end(); ++ci )
+        if( *ci != ' ' )
+            str += *ci;
+
+    const size_t colon_pos = str.find( ':' );
+    const std::string instruction_str = str.substr( 0, colon_pos );
+
+    if( !instruction_str.empty() && instruction_str != "*" )
+    {
+        if( !ParseNumber( instruction_str, mInstruction ) )
+            return false;
+
+        mMatchInstruction = true;
+    }
+
+    if( colon_pos == std::string::npos )
+        return true;
+
+    const std::string tdo_str = str.substr( colon_pos + 1 );
+    const size_t slash_pos = tdo_str.find( '/' );
+
+    if( !ParseNumber( tdo_str.substr( 0, slash_pos ), mTdo ) )
+        return false;
+
+    if( slash_pos != std::string::npos && !ParseNumber( tdo_str.substr( slash_pos + 1 ), mTdoMask ) )
+        return false;
+
+    mMatchTdo = true;
+    mTdo &= mTdoMask;
+
+    return true;
+}
+
+JtagSearchIndex::JtagSearchIndex() : mPendingInstructionFrame( JTAG_FRAME_NOT_STORED ), mInstructionKnown( false ), mInstruction( 0 )
+{
+}
+
+void JtagSearchIndex::AddInstructionBits( U64 frame_index, const JtagPackedBits& tdi_bits )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    // the scan is found by its first stored frame
+    if( mPendingInstructionFrame == JTAG_FRAME_NOT_STORED )
+        mPendingInstructionFrame = frame_index;
+
+    mPendingInstruction.Append( tdi_bits );
+}
+
+void JtagSearchIndex::UpdateInstruction( bool lsb_first )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    // without TDI there is nothing to go on
+    mInstructionKnown = mPendingInstruction.GetBitCount() > 0;
+
+    if( mInstructionKnown )
+    {
+        mInstruction = JtagBitView( mPendingInstruction, lsb_first ).GetTailValue();
+        if( mPendingInstructionFrame != JTAG_FRAME_NOT_STORED )
+            mInstructionScans[ mInstruction ].push_back( mPendingInstructionFrame );
+
+        mInstructionBits.Swap( mPendingInstruction );
+    }
+
+    ScanEntry entry;
+    entry.mInstructionLoaded = true;
+    entry.mInstructionKnown = mInstructionKnown;
+    entry.mInstruction = mInstruction;
+    entry.mTdo = 0;
+    mOpenScanEntries.push_back( entry );
+
+    mPendingInstruction.Clear();
+    mPendingInstructionFrame = JTAG_FRAME_NOT_STORED;
+}
+
+void JtagSearchIndex::ResetInstruction()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    mInstructionKnown = false;
+    mPendingInstruction.Clear();
+    mPendingInstructionFrame = JTAG_FRAME_NOT_STORED;
+}
+
+bool JtagSearchIndex::GetInstruction( U64& instruction )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    instruction = mInstruction;
+    return mInstructionKnown;
+}
+
+bool JtagSearchIndex::GetInstructionBits( JtagPackedBits& instruction_bits )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    instruction_bits = mInstructionBits;
+    return mInstructionKnown;
+}
+
+// spreads the bits of the value, so similar values use different bits of the Bloom filter
+static U64 HashValue( U64 value )
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDULL;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+void JtagSearchIndex::AddDataScan( U64 frame_index, U64 tdo_value )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    if( frame_index != JTAG_FRAME_NOT_STORED )
+        IndexDataScan( frame_index, tdo_value, mInstructionKnown, mInstruction );
+
+    ScanEntry entry;
+    entry.mInstructionLoaded = false;
+    entry.mInstructionKnown = mInstructionKnown;
+    entry.mInstruction = mInstruction;
+    entry.mTdo = tdo_value;
+    mOpenScanEntries.push_back( entry );
+}
+
+void JtagSearchIndex::EndScan()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    mRecentScans.push_back( std::vector<ScanEntry>() );
+    mRecentScans.back().swap( mOpenScanEntries );
+
+    if( mRecentScans.size() > JtagRepeatDetector::MAX_REPEAT_SCANS )
+        mRecentScans.pop_front();
+}
+
+void JtagSearchIndex::RepeatScans( U64 frame_index, size_t repeat_scans )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    if( frame_index == JTAG_FRAME_NOT_STORED || repeat_scans == 0 || repeat_scans > mRecentScans.size() )
+        return;
+
+    // the scans of the repeated block are the same as the last ones, so they load the same instructions
+    // and leave the same one loaded
+    for( size_t scan_idx = mRecentScans.size() - repeat_scans; scan_idx < mRecentScans.size(); ++scan_idx )
+    {
+        const std::vector<ScanEntry>& entries = mRecentScans[ scan_idx ];
+        for( std::vector<ScanEntry>::const_iterator ei( entries.begin() ); ei != entries.end(); ++ei )
+        {
+            if( !ei->mInstructionLoaded )
+            {
+                IndexDataScan( frame_index, ei->mTdo, ei->mInstructionKnown, ei->mInstruction );
+                continue;
+            }
+
+            if( !ei->mInstructionKnown )
+                continue;
+
+            // once per repeat frame, even if the block loads the instruction more than once
+            std::vector<U64>& instruction_scans = mInstructionScans[ ei->mInstruction ];
+            if( instruction_scans.empty() || instruction_scans.back() != frame_index )
+                instruction_scans.push_back( frame_index );
+        }
+    }
+}
+
+void JtagSearchIndex::IndexDataScan( U64 frame_index, U64 tdo_value, bool instruction_known, U64 instruction )
+{
+    if( mDataScans.size() % DATA_SCANS_PER_BLOCK == 0 )
+    {
+        mDataScanBlocks.push_back( DataScanBlock() );
+        mDataScanBlocks.back().mMinTdo = tdo_value;
+        mDataScanBlocks.back().mMaxTdo = tdo_value;
+    }
+
+    DataScanBlock& block = mDataScanBlocks.back();
+
+    if( block.mMinTdo > tdo_value )
+        block.mMinTdo = tdo_value;
+    if( block.mMaxTdo < tdo_value )
+        block.mMaxTdo = tdo_value;
+
+    const U64 hash = HashValue( tdo_value );
+    block.mTdoBloomFilter.set( hash % BLOOM_FILTER_BITS );
+    block.mTdoBloomFilter.set( ( hash >> 21 ) % BLOOM_FILTER_BITS );
+    block.mTdoBloomFilter.set( ( hash >> 42 ) % BLOOM_FILTER_BITS );
+
+    if( instruction_known )
+        mDataScansByInstruction[ instruction ].push_back( mDataScans.size() );
+
+    DataScan data_scan;
+    data_scan.mFrameIndex = frame_index;
+    data_scan.mTdo = tdo_value;
+    mDataScans.push_back( data_scan );
+}
+
+bool JtagSearchIndex::MightContain( const DataScanBlock& block, U64 tdo_value )
+{
+    if( tdo_value < block.mMinTdo || tdo_value > block.mMaxTdo )
+        return false;
+
+    const U64 hash = HashValue( tdo_value );
+    return block.mTdoBloomFilter.test( hash % BLOOM_FILTER_BITS ) && block.mTdoBloomFilter.test( ( hash >> 21 ) % BLOOM_FILTER_BITS ) &&
+           block.mTdoBloomFilter.test( ( hash >> 42 ) % BLOOM_FILTER_BITS );
+}
+
+bool JtagSearchIndex::Matches( const DataScan& data_scan, const JtagSearchQuery& query )
+{
+    return !query.mMatchTdo || ( data_scan.mTdo & query.mTdoMask ) == query.mTdo;
+}
+
+void JtagSearchIndex::Find( const JtagSearchQuery& query, std::vector<U64>& frame_indices )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    frame_indices.clear();
+
+    if( query.mMatchInstruction )
+    {
+        std::unordered_map<U64, std::vector<size_t> >::const_iterator di( mDataScansByInstruction.find( query.mInstruction ) );
+        if( di == mDataScansByInstruction.end() )
+            return;
+
+        for( std::vector<size_t>::const_iterator si( di->second.begin() ); si != di->second.end(); ++si )
+            if( Matches( mDataScans[ *si ], query ) )
+                frame_indices.push_back( mDataScans[ *si ].mFrameIndex );
+
+        return;
+    }
+
+    // the block summaries only help when looking for an exact value
+    const bool use_summaries = query.mMatchTdo && query.mTdoMask == ~0ULL;
+
+    for( size_t block_idx = 0; block_idx < mDataScanBlocks.size(); ++block_idx )
+    {
+        if( use_summaries && !MightContain( mDataScanBlocks[ block_idx ], query.mTdo ) )
+            continue;
+
+        const size_t scan_end = std::min( mDataScans.size(), ( block_idx + 1 ) * DATA_SCANS_PER_BLOCK );
+        for( size_t scan_idx = block_idx * DATA_SCANS_PER_BLOCK; scan_idx < scan_end; ++scan_idx )
+            if( Matches( mDataScans[ scan_idx ], query ) )
+                frame_indices.push_back( mDataScans[ scan_idx ].mFrameIndex );
+    }
+}
+
+void JtagSearchIndex::FindInstructionScans( U64 instruction, std::vector<U64>& frame_indices )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+
+    frame_indices.clear();
+
+    std::unordered_map<U64, std::vector<U64> >::const_iterator ii( mInstructionScans.find( instruction ) );
+    if( ii != mInstructionScans.end() )
+        frame_indices = ii->second;
+}
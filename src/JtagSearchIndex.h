@@ -0,0 +1,123 @@
+#ifndef JTAG_SEARCH_INDEX_H
+#define JTAG_SEARCH_INDEX_H
+
+#include <LogicPublicTypes.h>
+
+#include <bitset>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "JtagTypes.h"
+
+// Which scans to look for, parsed from "IR[:TDO[/MASK]]", e.g. "0x0E:0x1234/0xFFFF".
+// An IR of "*" or an empty query matches any instruction.
+struct JtagSearchQuery
+{
+    JtagSearchQuery();
+
+    // returns false if the query can't be parsed
+    bool Parse( const std::string& query );
+
+    bool mMatchInstruction;
+    U64 mInstruction;
+
+    bool mMatchTdo;
+    U64 mTdo;
+    U64 mTdoMask;
+};
+
+// Index of the shift frames, built while frames are added, so scans can be looked up by IR opcode
+// and DR value without going through every frame. Values wider than 64 bits are indexed by their
+// least significant 64 bits. The frames the store filter drops come with JTAG_FRAME_NOT_STORED; they
+// still load instructions and make up scans, but can't be found.
+class JtagSearchIndex
+{
+  public:
+    JtagSearchIndex();
+
+    // Shift-IR frames. The instruction is only loaded at Update-IR, and Pause-IR can split the scan
+    // over several frames, so the bits are collected until then.
+    void AddInstructionBits( U64 frame_index, const JtagPackedBits& tdi_bits );
+    void UpdateInstruction( bool lsb_first );
+
+    // Test-Logic-Reset loads a device specific instruction
+    void ResetInstruction();
+
+    // the instruction loaded by the last Update-IR; false if it isn't known
+    bool GetInstruction( U64& instruction );
+    bool GetInstructionBits( JtagPackedBits& instruction_bits );
+
+    void AddDataScan( U64 frame_index, U64 tdo_value );
+
+    // at Update-IR and Update-DR, the frames that end a scan
+    void EndScan();
+
+    // a JTAG_REPEATED_SCANS_FRAME indexes the scans it repeats once more, under its own frame index
+    void RepeatScans( U64 frame_index, size_t repeat_scans );
+
+    // the Shift-DR frames matching the query, in frame order
+    void Find( const JtagSearchQuery& query, std::vector<U64>& frame_indices );
+
+    // the first Shift-IR frame of every scan that loaded the instruction
+    void FindInstructionScans( U64 instruction, std::vector<U64>& frame_indices );
+
+  protected:
+    struct DataScan
+    {
+        U64 mFrameIndex;
+        U64 mTdo;
+    };
+
+    static const size_t DATA_SCANS_PER_BLOCK = 1024;
+    static const size_t BLOOM_FILTER_BITS = 8192;
+
+    // summary of DATA_SCANS_PER_BLOCK data scans, so blocks can be skipped when looking for a TDO value
+    struct DataScanBlock
+    {
+        U64 mMinTdo;
+        U64 mMaxTdo;
+        std::bitset<BLOOM_FILTER_BITS> mTdoBloomFilter;
+    };
+
+    // what a scan added to the index: the instruction it loaded, or the TDO value of a data scan
+    struct ScanEntry
+    {
+        bool mInstructionLoaded;
+        bool mInstructionKnown;
+        U64 mInstruction;
+        U64 mTdo;
+    };
+
+    void IndexDataScan( U64 frame_index, U64 tdo_value, bool instruction_known, U64 instruction );
+
+    static bool MightContain( const DataScanBlock& block, U64 tdo_value );
+    static bool Matches( const DataScan& data_scan, const JtagSearchQuery& query );
+
+    // the instruction being shifted in
+    JtagPackedBits mPendingInstruction;
+    U64 mPendingInstructionFrame;
+
+    // the instruction loaded by the last Update-IR, and all of its bits in shift order
+    bool mInstructionKnown;
+    U64 mInstruction;
+    JtagPackedBits mInstructionBits;
+
+    std::vector<DataScan> mDataScans;
+    std::vector<DataScanBlock> mDataScanBlocks;
+
+    // instruction -> first Shift-IR frame of each scan that loaded it
+    std::unordered_map<U64, std::vector<U64> > mInstructionScans;
+    // instruction -> data scans made while it was loaded, as indices into mDataScans
+    std::unordered_map<U64, std::vector<size_t> > mDataScansByInstruction;
+
+    // the entries of the open scan, and of the last scans, enough for the longest repeat
+    std::vector<ScanEntry> mOpenScanEntries;
+    std::deque<std::vector<ScanEntry> > mRecentScans;
+
+    std::mutex mMutex;
+};
+
+#endif // JTAG_SEARCH_INDEX_H
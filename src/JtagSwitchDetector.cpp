@@ -0,0 +1,148 @@
+#include "JtagSwitchDetector.h"
+
+// the select sequences, as the numbers they make sent LSB first
+const U16 JTAG_TO_SWD_SEQUENCE = 0xE79E;
+const U16 SWD_TO_JTAG_SEQUENCE = 0xE73C;
+const U16 SWD_TO_DORMANT_SEQUENCE = 0xE3BC;
+const U64 JTAG_TO_DORMANT_SEQUENCE = 0x33BBBBBA;
+
+// the selection alert, as the newer and older halves of the shift register
+const U64 SELECTION_ALERT_HIGH = 0x19BC0EA2E3DDAFE9ULL;
+const U64 SELECTION_ALERT_LOW = 0x86852D956209F392ULL;
+
+// the 4 zeros after the selection alert and the SWD activation code, as the last 12 bits
+const U64 SWD_ACTIVATION = 0x1A0;
+
+JtagSwitchDetector::JtagSwitchDetector()
+{
+    Init( false );
+}
+
+void JtagSwitchDetector::Init( bool enabled )
+{
+    mEnabled = enabled;
+    mMode = DebugPortJtag;
+
+    mBits = 0;
+    mOlderBits = 0;
+    mAlerted = false;
+    mActivationBits = 0;
+
+    mInSpan = false;
+    mFilteredResets.clear();
+}
+
+JtagDebugPortMode JtagSwitchDetector::AddBit( U8 tms )
+{
+    mOlderBits = ( mOlderBits >> 1 ) | ( mBits << 63 );
+    mBits = ( mBits >> 1 ) | ( U64( tms == BIT_HIGH ) << 63 );
+
+    switch( mMode )
+    {
+    case DebugPortJtag:
+        if( IsSelectSequence( JTAG_TO_SWD_SEQUENCE ) )
+            mMode = DebugPortSwd;
+        else if( ( mBits >> 28 ) == ( ( JTAG_TO_DORMANT_SEQUENCE << 5 ) | 0x1F ) )
+            mMode = DebugPortDormant;
+        break;
+    case DebugPortSwd:
+        if( IsSelectSequence( SWD_TO_JTAG_SEQUENCE ) )
+            mMode = DebugPortJtag;
+        else if( IsSelectSequence( SWD_TO_DORMANT_SEQUENCE ) )
+            mMode = DebugPortDormant;
+        break;
+    default:
+        if( mBits == SELECTION_ALERT_HIGH && mOlderBits == SELECTION_ALERT_LOW )
+        {
+            mAlerted = true;
+            mActivationBits = 0;
+        }
+        else if( mAlerted )
+        {
+            ++mActivationBits;
+            if( mActivationBits == 12 && ( mBits >> 52 ) == SWD_ACTIVATION )
+            {
+                mMode = DebugPortSwd;
+                mAlerted = false;
+            }
+            else if( mActivationBits == 16 )
+            {
+                if( ( mBits >> 48 ) == 0 )
+                    mMode = DebugPortJtag;
+                mAlerted = false;
+            }
+        }
+        break;
+    }
+
+    return mMode;
+}
+
+void JtagSwitchDetector::Filter( std::vector<JtagClockSample>& clocks, std::vector<JtagResetEvent>& resets )
+{
+    if( !mEnabled )
+        return;
+
+    mFilteredResets.clear();
+
+    const size_t num_clocks = clocks.size();
+    size_t kept_clocks = 0;
+    size_t reset_idx = 0;
+
+    for( size_t clock_idx = 0; clock_idx <= num_clocks; ++clock_idx )
+    {
+        // the resets before this clock, in the mode the clock is in
+        for( ; reset_idx < resets.size() && ( clock_idx == num_clocks || resets[ reset_idx ].mClockIndex <= clock_idx ); ++reset_idx )
+        {
+            if( mMode != DebugPortJtag )
+                continue;
+
+            mFilteredResets.push_back( resets[ reset_idx ] );
+            mFilteredResets.back().mClockIndex = kept_clocks;
+        }
+
+        if( clock_idx == num_clocks )
+            break;
+
+        const JtagClockSample clock = clocks[ clock_idx ];
+        const JtagDebugPortMode mode = mMode;
+
+        if( mode == DebugPortJtag )
+            clocks[ kept_clocks++ ] = clock;
+        else
+        {
+            if( !mInSpan )
+            {
+                mInSpan = true;
+                mSpan.mSampleNumber = clock.mSampleNumber;
+                mSpan.mMode = mode;
+                mSpan.mClockCount = 0;
+            }
+
+            mSpan.mEndingSampleNumber = clock.mSampleNumber;
+            ++mSpan.mClockCount;
+        }
+
+        // the span ends with the sequence that switches out of its mode
+        if( AddBit( clock.mTms ) != mode && mode != DebugPortJtag )
+        {
+            mSpan.mClockIndex = kept_clocks;
+            mFilteredResets.push_back( mSpan );
+            mInSpan = false;
+        }
+    }
+
+    clocks.resize( kept_clocks );
+    resets.swap( mFilteredResets );
+}
+
+bool JtagSwitchDetector::EndSpan( JtagResetEvent& reset )
+{
+    if( !mInSpan )
+        return false;
+
+    reset = mSpan;
+    reset.mClockIndex = 0;
+    mInSpan = false;
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef JTAG_SWITCH_DETECTOR_H
+#define JTAG_SWITCH_DETECTOR_H
+
+#include <vector>
+
+#include "JtagTapDecoder.h"
+
+// Follows an ARM SWJ-DP through its switch sequences on TMS/SWDIO, all sent LSB first:
+//  JTAG to SWD       at least 50 ones, then 0xE79E
+//  SWD to JTAG       at least 50 ones, then 0xE73C
+//  JTAG to dormant   at least 5 ones, then the 31 bits of 0x33BBBBBA
+//  SWD to dormant    at least 50 ones, then 0xE3BC
+//  dormant to active the 128 bit selection alert, 4 zeros, then the activation code: 0x1A for SWD, 12 zeros for JTAG
+// The TMS bits go through a 128 bit shift register, so a sequence is matched with a few word compares
+// when its last bit comes in. The bits of a sequence belong to the mode it switches from.
+class JtagSwitchDetector
+{
+  public:
+    JtagSwitchDetector();
+
+    // starts over in JTAG mode; when disabled, the clocks are left alone
+    void Init( bool enabled );
+
+    // takes the clocks out of JTAG mode out of clocks, and adds an event standing in for them to resets where
+    // JTAG mode resumes. TRST events out of JTAG mode are dropped, the others move with their clocks.
+    void Filter( std::vector<JtagClockSample>& clocks, std::vector<JtagResetEvent>& resets );
+
+    // ends the span out of JTAG mode at the end of the capture, if there is one. The mode carries on, so the
+    // clocks after a pause start another span.
+    bool EndSpan( JtagResetEvent& reset );
+
+  protected:
+    // shifts in a TMS bit, and returns the mode after it
+    JtagDebugPortMode AddBit( U8 tms );
+
+    // the last 16 bits are sequence, with at least 50 ones before them
+    bool IsSelectSequence( U16 sequence ) const
+    {
+        return ( mBits >> 48 ) == sequence && ( mBits & 0xFFFFFFFFFFFFULL ) == 0xFFFFFFFFFFFFULL && ( mOlderBits >> 62 ) == 3;
+    }
+
+    bool mEnabled;
+    JtagDebugPortMode mMode;
+
+    // the last 128 TMS bits, the newest one in the top bit of mBits
+    U64 mBits;
+    U64 mOlderBits;
+
+    // waiting for the activation code, and the bits since the selection alert
+    bool mAlerted;
+    U32 mActivationBits;
+
+    // the span out of JTAG mode so far
+    bool mInSpan;
+    JtagResetEvent mSpan;
+
+    std::vector<JtagResetEvent> mFilteredResets;
+};
+
+#endif // JTAG_SWITCH_DETECTOR_H
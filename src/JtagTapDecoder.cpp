@@ -0,0 +1,182 @@
+#include "JtagTapDecoder.h"
+#include "JtagAnalyzerSettings.h"
+
+JtagTapDecoder::JtagTapDecoder() : mSettings( NULL ), mHasTdi( false ), mHasTdo( false ), mHasPrevClock( false ), mPrevClockSample( 0 )
+{
+}
+
+void JtagTapDecoder::Init( const JtagAnalyzerSettings* settings )
+{
+    mSettings = settings;
+    mHasTdi = settings->HasTdi();
+    mHasTdo = settings->HasTdo();
+}
+
+void JtagTapDecoder::Start( JtagTAPState tap_state, bool state_known, U64 starting_sample )
+{
+    if( state_known )
+        mTAPCtrl.SetState( tap_state );
+    else
+        mTAPCtrl.SetStateUnknown( tap_state );
+
+    mFrame.mData1 = 0;
+    mFrame.mData2 = 0;
+
+    mTdiBits.Clear();
+    mTdoBits.Clear();
+
+    mHasPrevClock = false;
+
+    StartFrame( starting_sample );
+}
+
+U8 JtagTapDecoder::GetTAPStateFlags() const
+{
+    if( mTAPCtrl.IsStateKnown() )
+        return 0;
+
+    return JTAG_FLAG_STATE_UNCERTAIN | DISPLAY_AS_WARNING_FLAG;
+}
+
+void JtagTapDecoder::StartFrame( U64 starting_sample_number )
+{
+    mFrame.mStartingSampleInclusive = starting_sample_number;
+    mFrame.mType = mTAPCtrl.GetCurrState();
+    mFrame.mFlags = GetTAPStateFlags();
+    mTiming.Clear();
+}
+
+void JtagTapDecoder::CloseFrame( U64 ending_sample_number )
+{
+    mDecodedFrames.push_back( JtagDecodedFrame() );
+    JtagDecodedFrame& decoded_frame = mDecodedFrames.back();
+
+    // save the TDI/TDO values with the frame, as they were shifted
+    if( mFrame.mType == ShiftIR || mFrame.mType == ShiftDR )
+    {
+        mTdiBits.MoveTo( decoded_frame.mShiftedData.mTdiBits );
+        mTdoBits.MoveTo( decoded_frame.mShiftedData.mTdoBits );
+    }
+
+    if( mTiming.HasMarginViolation() )
+        mFrame.mFlags |= JTAG_FLAG_MARGIN_VIOLATION | DISPLAY_AS_WARNING_FLAG;
+
+    mFrame.mEndingSampleInclusive = ending_sample_number;
+    decoded_frame.mFrame = mFrame;
+    decoded_frame.mNextState = mTAPCtrl.GetCurrState();
+    decoded_frame.mTiming = mTiming;
+}
+
+void JtagTapDecoder::CloseOpenFrame( U64 ending_sample )
+{
+    if( S64( ending_sample ) < mFrame.mStartingSampleInclusive )
+        return;
+
+    CloseFrame( ending_sample );
+    StartFrame( ending_sample + 1 );
+}
+
+void JtagTapDecoder::Reset( const JtagResetEvent& reset )
+{
+    if( reset.mMode == DebugPortJtag )
+    {
+        // close the frame and reset the TAP state
+        CloseFrame( reset.mSampleNumber );
+    }
+    else
+    {
+        // the frame before the switch ends where JTAG mode did, unless it has no clocks of its own
+        U64 starting_sample = reset.mSampleNumber;
+        if( mTiming.mClockCount != 0 )
+            CloseFrame( reset.mSampleNumber - 1 );
+        else
+            starting_sample = mFrame.mStartingSampleInclusive;
+
+        mDecodedFrames.push_back( JtagDecodedFrame() );
+        JtagDecodedFrame& decoded_frame = mDecodedFrames.back();
+        decoded_frame.mFrame.mType = JTAG_SUSPENDED_FRAME;
+        decoded_frame.mFrame.mFlags = 0;
+        decoded_frame.mFrame.mData1 = reset.mMode;
+        decoded_frame.mFrame.mData2 = reset.mClockCount;
+        decoded_frame.mFrame.mStartingSampleInclusive = starting_sample;
+        decoded_frame.mFrame.mEndingSampleInclusive = reset.mEndingSampleNumber;
+        decoded_frame.mNextState = TestLogicReset;
+    }
+
+    mTAPCtrl.SetState( TestLogicReset );
+    StartFrame( reset.mEndingSampleNumber + 1 );
+    mHasPrevClock = false;
+}
+
+void JtagTapDecoder::Decode( std::vector<JtagClockSample>& clocks, size_t clock_begin, size_t clock_end, const JtagResetEvent* resets,
+                             size_t num_resets )
+{
+    const U32 bits_per_data_unit = mSettings->mShiftDRBitsPerDataUnit;
+    size_t reset_idx = 0;
+
+    for( size_t clock_idx = clock_begin; clock_idx <= clock_end; ++clock_idx )
+    {
+        // TRST asserted before this clock?
+        while( reset_idx < num_resets && ( clock_idx == clock_end || resets[ reset_idx ].mClockIndex <= clock_idx ) )
+        {
+            Reset( resets[ reset_idx ] );
+            ++reset_idx;
+        }
+
+        if( clock_idx == clock_end )
+            break;
+
+        JtagClockSample& clock = clocks[ clock_idx ];
+        clock.mFlags = 0;
+
+        // the period ending on this clock
+        mTiming.AddClock( clock.mSampleNumber );
+        mTiming.AddMargins( clock.mSetupMargin, clock.mHoldMargin );
+        if( mHasPrevClock )
+        {
+            const U64 period = clock.mSampleNumber - mPrevClockSample;
+            const bool falling_edge_seen = clock.mFallingSampleNumber > mPrevClockSample && clock.mFallingSampleNumber < clock.mSampleNumber;
+
+            mTiming.AddPeriod( period, falling_edge_seen ? clock.mFallingSampleNumber - mPrevClockSample : 0 );
+            mPeriodHistogram.Add( period );
+        }
+
+        mHasPrevClock = true;
+        mPrevClockSample = clock.mSampleNumber;
+
+        // save TDI and TDO data
+        if( mTAPCtrl.GetCurrState() == ShiftIR || mTAPCtrl.GetCurrState() == ShiftDR )
+        {
+            size_t bitCount = 0;
+
+            if( mHasTdi )
+            {
+                mTdiBits.PushBack( clock.mTdi );
+                bitCount = mTdiBits.GetBitCount();
+            }
+
+            if( mHasTdo )
+            {
+                mTdoBits.PushBack( clock.mTdo );
+                bitCount = mTdoBits.GetBitCount();
+            }
+
+            clock.mFlags |= JTAG_CLOCK_SHIFTED;
+
+            if( ( bits_per_data_unit != 0 ) && ( bitCount >= bits_per_data_unit ) )
+            {
+                CloseFrame( clock.mSampleNumber );
+                StartFrame( clock.mSampleNumber + 1 );
+            }
+        }
+
+        // send TMS state to the TAP state machine - returns true if state machine has changed
+        if( mTAPCtrl.AdvanceState( BitState( clock.mTms ) ) )
+        {
+            clock.mFlags |= JTAG_CLOCK_STATE_CHANGED;
+
+            CloseFrame( clock.mSampleNumber );
+            StartFrame( clock.mSampleNumber + 1 );
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#ifndef JTAG_TAP_DECODER_H
+#define JTAG_TAP_DECODER_H
+
+#include <AnalyzerResults.h>
+
+#include <thread>
+#include <vector>
+
+#include "JtagTckTiming.h"
+#include "JtagTypes.h"
+
+class JtagAnalyzerSettings;
+
+// JtagClockSample::mFlags, filled in by the decoder
+const U8 JTAG_CLOCK_SHIFTED = 0x01;       // TDI/TDO were shifted on this clock
+const U8 JTAG_CLOCK_STATE_CHANGED = 0x02; // TMS changed the TAP state on this clock
+
+// One rising edge of TCK, as captured from the channel data
+struct JtagClockSample
+{
+    U64 mSampleNumber;
+    U64 mFallingSampleNumber; // the falling edge of TCK before this clock, 0 if it wasn't seen
+    U64 mTmsSampleNumber;     // where TMS, TDI and TDO were read, after the sampling edge and delay
+    U64 mTdiSampleNumber;
+    U64 mTdoSampleNumber;
+    U32 mSetupMargin;         // samples from the last TMS/TDI/TDO change to this clock, if under the threshold
+    U32 mHoldMargin;          // samples from this clock to the next TMS/TDI/TDO change, if under the threshold
+    U8 mTms;
+    U8 mTdi;
+    U8 mTdo;
+    U8 mFlags;
+};
+
+// TRST was asserted between two TCK clocks, or the debug port was out of JTAG mode for the clocks in between
+struct JtagResetEvent
+{
+    size_t mClockIndex;      // the reset happens before this clock
+    U64 mSampleNumber;       // the falling edge of TRST, or the first clock out of JTAG mode
+    U64 mEndingSampleNumber; // the same as mSampleNumber for TRST, or the last clock out of JTAG mode
+    JtagDebugPortMode mMode; // DebugPortJtag for TRST
+    U64 mClockCount;         // the clocks out of JTAG mode, 0 for TRST
+};
+
+// A closed frame with its TDI/TDO data, ready to be added to the results
+struct JtagDecodedFrame
+{
+    Frame mFrame;
+    JtagShiftedData mShiftedData; // only used for Shift-IR/Shift-DR frames
+    JtagTAPState mNextState;      // the TAP state right after the frame was closed
+    JtagTckTiming mTiming;        // the clocks of the frame
+};
+
+// Runs the TAP state machine over captured clocks and splits them into frames.
+// The decoder doesn't touch the channel data or the results, so independent decoders
+// can work on different segments of the capture at the same time.
+class JtagTapDecoder
+{
+  public:
+    JtagTapDecoder();
+
+    void Init( const JtagAnalyzerSettings* settings );
+
+    // starts decoding in tap_state with an open frame beginning at starting_sample
+    void Start( JtagTAPState tap_state, bool state_known, U64 starting_sample );
+
+    // times the first clock from the rising edge of TCK before it
+    void SetPrevClock( U64 sample_number )
+    {
+        mHasPrevClock = true;
+        mPrevClockSample = sample_number;
+    }
+
+    // decodes clocks [clock_begin, clock_end). The resets are applied before the clock they belong to,
+    // resets past the last clock are applied at the end.
+    void Decode( std::vector<JtagClockSample>& clocks, size_t clock_begin, size_t clock_end, const JtagResetEvent* resets,
+                 size_t num_resets );
+
+    // closes the frame that is still being decoded, and starts the next one in the same state after ending_sample
+    void CloseOpenFrame( U64 ending_sample );
+
+    // closes the frame at a TRST assertion, or adds a JTAG_SUSPENDED_FRAME for the time out of JTAG mode,
+    // and goes on in Test-Logic-Reset
+    void Reset( const JtagResetEvent& reset );
+
+    // the frame that is still being decoded
+    Frame& GetOpenFrame()
+    {
+        return mFrame;
+    }
+
+    JtagTckTiming& GetOpenTiming()
+    {
+        return mTiming;
+    }
+
+    std::vector<JtagDecodedFrame>& GetDecodedFrames()
+    {
+        return mDecodedFrames;
+    }
+
+    // the TCK periods of all clocks decoded so far
+    JtagTimingHistogram& GetPeriodHistogram()
+    {
+        return mPeriodHistogram;
+    }
+
+  protected:
+    // frame flags for the current TAP state; marks frames as uncertain until the state is known
+    U8 GetTAPStateFlags() const;
+
+    // closes the frame, and handles the tdi/tdo data
+    void CloseFrame( U64 ending_sample_number );
+    void StartFrame( U64 starting_sample_number );
+
+    const JtagAnalyzerSettings* mSettings;
+    bool mHasTdi;
+    bool mHasTdo;
+
+    JtagTAP_Controller mTAPCtrl;
+
+    Frame mFrame;
+    JtagPackedBitsBuilder mTdiBits; // of the open shift frame
+    JtagPackedBitsBuilder mTdoBits;
+    JtagTckTiming mTiming;
+
+    // the rising edge before the next clock, unless a reset came in between
+    bool mHasPrevClock;
+    U64 mPrevClockSample;
+    JtagTimingHistogram mPeriodHistogram;
+
+    std::vector<JtagDecodedFrame> mDecodedFrames;
+};
+
+// Joins all of its threads when it goes out of scope
+class JtagThreadGroup
+{
+  public:
+    ~JtagThreadGroup()
+    {
+        for( std::vector<std::thread>::iterator ti( mThreads.begin() ); ti != mThreads.end(); ++ti )
+            ti->join();
+    }
+
+    void Add( std::thread&& thread )
+    {
+        mThreads.push_back( std::move( thread ) );
+    }
+
+  protected:
+    std::vector<std::thread> mThreads;
+};
+
+#endif // JTAG_TAP_DECODER_H
@@ -0,0 +1,162 @@
+#include <algorithm>
+
+#include "JtagTckTiming.h"
+
+JtagTckTiming::JtagTckTiming()
+{
+    Clear();
+}
+
+void JtagTckTiming::Clear()
+{
+    mClockCount = 0;
+    mFirstClockSample = 0;
+    mLastClockSample = 0;
+
+    mPeriodCount = 0;
+    mPeriodSum = 0;
+    mMinPeriod = 0;
+    mMaxPeriod = 0;
+
+    mDutyPeriodSum = 0;
+    mHighTimeSum = 0;
+
+    mMinSetupMargin = JTAG_NO_MARGIN_VIOLATION;
+    mMinHoldMargin = JTAG_NO_MARGIN_VIOLATION;
+}
+
+void JtagTckTiming::AddClock( U64 sample_number )
+{
+    if( mClockCount == 0 )
+        mFirstClockSample = sample_number;
+
+    mLastClockSample = sample_number;
+    ++mClockCount;
+}
+
+void JtagTckTiming::AddPeriod( U64 period, U64 high_time )
+{
+    if( mPeriodCount == 0 || period < mMinPeriod )
+        mMinPeriod = period;
+    if( period > mMaxPeriod )
+        mMaxPeriod = period;
+
+    ++mPeriodCount;
+    mPeriodSum += period;
+
+    if( high_time != 0 )
+    {
+        mDutyPeriodSum += period;
+        mHighTimeSum += high_time;
+    }
+}
+
+void JtagTckTiming::AddMargins( U32 setup_margin, U32 hold_margin )
+{
+    mMinSetupMargin = std::min( mMinSetupMargin, setup_margin );
+    mMinHoldMargin = std::min( mMinHoldMargin, hold_margin );
+}
+
+void JtagTckTiming::Merge( const JtagTckTiming& other )
+{
+    if( other.mClockCount != 0 )
+    {
+        if( mClockCount == 0 || other.mFirstClockSample < mFirstClockSample )
+            mFirstClockSample = other.mFirstClockSample;
+        mLastClockSample = std::max( mLastClockSample, other.mLastClockSample );
+        mClockCount += other.mClockCount;
+    }
+
+    if( other.mPeriodCount != 0 )
+    {
+        if( mPeriodCount == 0 || other.mMinPeriod < mMinPeriod )
+            mMinPeriod = other.mMinPeriod;
+        mMaxPeriod = std::max( mMaxPeriod, other.mMaxPeriod );
+        mPeriodCount += other.mPeriodCount;
+        mPeriodSum += other.mPeriodSum;
+    }
+
+    mDutyPeriodSum += other.mDutyPeriodSum;
+    mHighTimeSum += other.mHighTimeSum;
+
+    AddMargins( other.mMinSetupMargin, other.mMinHoldMargin );
+}
+
+double JtagTckTiming::GetFrequency( U32 sample_rate ) const
+{
+    if( mPeriodSum == 0 )
+        return 0.0;
+
+    return double( sample_rate ) * double( mPeriodCount ) / double( mPeriodSum );
+}
+
+double JtagTckTiming::GetDutyCycle() const
+{
+    if( mDutyPeriodSum == 0 )
+        return 0.0;
+
+    return 100.0 * double( mHighTimeSum ) / double( mDutyPeriodSum );
+}
+
+JtagTimingHistogram::JtagTimingHistogram() : mTotalCount( 0 )
+{
+}
+
+size_t JtagTimingHistogram::GetBucket( U64 samples )
+{
+    if( samples == 0 )
+        return 0;
+
+    size_t octave = 63;
+    while( ( samples >> octave ) == 0 )
+        --octave;
+
+    // the two bits below the leading one pick the bucket in the octave
+    const size_t sub_bucket = ( octave >= 2 ? samples >> ( octave - 2 ) : samples << ( 2 - octave ) ) & ( BUCKETS_PER_OCTAVE - 1 );
+
+    return octave * BUCKETS_PER_OCTAVE + sub_bucket;
+}
+
+U64 JtagTimingHistogram::GetBucketBegin( size_t bucket )
+{
+    const size_t octave = bucket / BUCKETS_PER_OCTAVE;
+    const U64 mantissa = BUCKETS_PER_OCTAVE + bucket % BUCKETS_PER_OCTAVE;
+
+    return octave >= 2 ? mantissa << ( octave - 2 ) : mantissa >> ( 2 - octave );
+}
+
+U64 JtagTimingHistogram::GetBucketEnd( size_t bucket )
+{
+    const size_t octave = bucket / BUCKETS_PER_OCTAVE;
+    const U64 mantissa = BUCKETS_PER_OCTAVE + bucket % BUCKETS_PER_OCTAVE;
+
+    // the buckets of the two lowest octaves hold a single duration
+    return octave >= 2 ? ( mantissa + 1 ) << ( octave - 2 ) : ( mantissa >> ( 2 - octave ) ) + 1;
+}
+
+void JtagTimingHistogram::Add( U64 samples )
+{
+    const size_t bucket = GetBucket( samples );
+    if( bucket >= mCounts.size() )
+        mCounts.resize( bucket + 1, 0 );
+
+    ++mCounts[ bucket ];
+    ++mTotalCount;
+}
+
+void JtagTimingHistogram::Merge( const JtagTimingHistogram& other )
+{
+    if( other.mCounts.size() > mCounts.size() )
+        mCounts.resize( other.mCounts.size(), 0 );
+
+    for( size_t bucket = 0; bucket < other.mCounts.size(); ++bucket )
+        mCounts[ bucket ] += other.mCounts[ bucket ];
+
+    mTotalCount += other.mTotalCount;
+}
+
+void JtagTimingHistogram::Clear()
+{
+    mCounts.clear();
+    mTotalCount = 0;
+}
@@ -0,0 +1,93 @@
+#ifndef JTAG_TCK_TIMING_H
+#define JTAG_TCK_TIMING_H
+
+#include <LogicPublicTypes.h>
+
+#include <vector>
+
+// setup/hold margin of a clock or frame where no data line came closer than the threshold
+const U32 JTAG_NO_MARGIN_VIOLATION = 0xFFFFFFFF;
+
+// TCK timing of the clocks in a frame, in samples. A clock period counts towards the frame of
+// the rising edge it ends on.
+struct JtagTckTiming
+{
+    JtagTckTiming();
+
+    void Clear();
+
+    void AddClock( U64 sample_number );
+
+    // high_time is 0 when the falling edge in the period wasn't seen
+    void AddPeriod( U64 period, U64 high_time );
+
+    void AddMargins( U32 setup_margin, U32 hold_margin );
+
+    void Merge( const JtagTckTiming& other );
+
+    bool HasMarginViolation() const
+    {
+        return mMinSetupMargin != JTAG_NO_MARGIN_VIOLATION || mMinHoldMargin != JTAG_NO_MARGIN_VIOLATION;
+    }
+
+    // in Hz and percent; only meaningful with at least one period
+    double GetFrequency( U32 sample_rate ) const;
+    double GetDutyCycle() const;
+
+    U64 mClockCount;
+    U64 mFirstClockSample;
+    U64 mLastClockSample;
+
+    U64 mPeriodCount;
+    U64 mPeriodSum;
+    U64 mMinPeriod;
+    U64 mMaxPeriod;
+
+    // the periods the falling edge was seen in, and how long TCK was high in them
+    U64 mDutyPeriodSum;
+    U64 mHighTimeSum;
+
+    // the smallest margins of the data lines to a rising edge that were under the setup/hold threshold
+    U32 mMinSetupMargin;
+    U32 mMinHoldMargin;
+};
+
+// Histogram of durations in samples, with BUCKETS_PER_OCTAVE logarithmic buckets per power of two
+class JtagTimingHistogram
+{
+  public:
+    JtagTimingHistogram();
+
+    void Add( U64 samples );
+    void Merge( const JtagTimingHistogram& other );
+    void Clear();
+
+    bool IsEmpty() const
+    {
+        return mTotalCount == 0;
+    }
+
+    size_t GetBucketCount() const
+    {
+        return mCounts.size();
+    }
+
+    U64 GetCount( size_t bucket ) const
+    {
+        return mCounts[ bucket ];
+    }
+
+    // the shortest duration in the bucket, and the shortest one past it
+    static U64 GetBucketBegin( size_t bucket );
+    static U64 GetBucketEnd( size_t bucket );
+
+  protected:
+    static const size_t BUCKETS_PER_OCTAVE = 4;
+
+    static size_t GetBucket( U64 samples );
+
+    std::vector<U64> mCounts;
+    U64 mTotalCount;
+};
+
+#endif // JTAG_TCK_TIMING_H
@@ -32,7 +32,7 @@ const JtagTAPStateChange tap_state_change_map[] = {
     { RunTestIdle, SelectDRScan }, // UpdateIR
 };
 
-JtagTAP_Controller::JtagTAP_Controller() : mCurrTAPState( RunTestIdle )
+JtagTAP_Controller::JtagTAP_Controller() : mCurrTAPState( RunTestIdle ), mCandidateStates( U16( 1 << RunTestIdle ) )
 {
 }
 
@@ -45,6 +45,25 @@ bool JtagTAP_Controller::AdvanceState( BitState tms_state )
     else
         new_state = tap_state_change_map[ mCurrTAPState ].tms_low_change;
 
+    // run the whole candidate set through the transition table until it collapses.
+    // mCurrTAPState is a member of the set, so its successor always is too.
+    if( !IsStateKnown() )
+    {
+        U16 new_candidates = 0;
+        for( int state_cnt = 0; state_cnt < NUM_TAP_STATES; ++state_cnt )
+        {
+            if( ( mCandidateStates & ( 1 << state_cnt ) ) == 0 )
+                continue;
+
+            if( tms_state == BIT_HIGH )
+                new_candidates |= 1 << tap_state_change_map[ state_cnt ].tms_high_change;
+            else
+                new_candidates |= 1 << tap_state_change_map[ state_cnt ].tms_low_change;
+        }
+
+        mCandidateStates = new_candidates;
+    }
+
     bool ret_val = new_state != mCurrTAPState;
 
     mCurrTAPState = new_state;
@@ -52,14 +71,13 @@ bool JtagTAP_Controller::AdvanceState( BitState tms_state )
     return ret_val;
 }
 
-std::string JtagShiftedData::GetDecimalString( const std::vector<U8>& bits )
+std::string JtagShiftedData::GetDecimalString( const JtagBitView& bits )
 {
     std::string ret_val( "0" );
-    std::vector<U8>::const_iterator bi( bits.begin() );
     int carry, digit;
-    while( bi != bits.end() )
+    for( U64 bit_idx = 0; bit_idx < bits.GetBitCount(); ++bit_idx )
     {
-        carry = *bi ? 1 : 0;
+        carry = bits.GetBit( bit_idx ) == BIT_HIGH ? 1 : 0;
 
         // multiply ret_val by 2 and add the carry bit
         std::string::reverse_iterator ai( ret_val.rbegin() );
@@ -74,29 +92,25 @@ std::string JtagShiftedData::GetDecimalString( const std::vector<U8>& bits )
 
         if( carry > 0 )
             ret_val = char( carry + '0' ) + ret_val;
-
-        ++bi;
     }
 
     return ret_val;
 }
 
-std::string JtagShiftedData::GetASCIIString( const std::vector<U8>& bits )
+std::string JtagShiftedData::GetASCIIString( const JtagBitView& bits )
 {
     std::string ret_val;
 
     // Check if the value of the number represented by bits is less than 0x100.
     // If it is, we can make an ASCII out of it, otherwise use GetDecimalString()
-    std::vector<U8>::const_iterator srch_hi( std::find( bits.begin(), bits.end(), BIT_HIGH ) );
-    if( bits.end() - srch_hi <= 8 )
-    {
-        // Get the numerical value from the bits.
-        U64 val;
+    U64 srch_hi = 0;
+    while( srch_hi < bits.GetBitCount() && bits.GetBit( srch_hi ) != BIT_HIGH )
+        ++srch_hi;
 
+    if( bits.GetBitCount() - srch_hi <= 8 )
+    {
         // Only get the 8 least significant bits
-        std::vector<U8>::const_iterator bsi( bits.end() - 8 );
-        for( val = 0; bsi != bits.end(); ++bsi )
-            val = ( val << 1 ) | ( *bsi == BIT_HIGH ? 1 : 0 );
+        U64 val = bits.GetValue( bits.GetBitCount() - 8, 8 );
 
         // make a string out of that value
         char number_str[ 32 ];
@@ -112,25 +126,22 @@ std::string JtagShiftedData::GetASCIIString( const std::vector<U8>& bits )
     return ret_val;
 }
 
-std::string JtagShiftedData::GetHexOrBinaryString( const std::vector<U8>& bits, DisplayBase display_base )
+std::string JtagShiftedData::GetHexOrBinaryString( const JtagBitView& bits, DisplayBase display_base )
 {
     std::string ret_val;
-    std::vector<U8>::const_iterator bsi( bits.begin() );
 
     U64 val;
-    size_t remain_bits = bits.size(), chunk_bits, bit_cnt;
+    U64 bit_idx = 0, remain_bits = bits.GetBitCount(), chunk_bits;
     char number_str[ 128 ];
-    while( bsi != bits.end() )
+    while( remain_bits > 0 )
     {
         chunk_bits = remain_bits % 64;
         if( chunk_bits == 0 )
             chunk_bits = 64;
 
         // make a 64 bit value
-        for( bit_cnt = chunk_bits, val = 0; bsi != bits.end() && bit_cnt > 0; ++bsi, --bit_cnt )
-        {
-            val = ( val << 1 ) | ( *bsi == BIT_HIGH ? 1 : 0 );
-        }
+        val = bits.GetValue( bit_idx, chunk_bits );
+        bit_idx += chunk_bits;
 
         // make a string out of that value
         AnalyzerHelpers::GetNumberString( val, display_base, ( U32 )chunk_bits, number_str, sizeof( number_str ) );
@@ -147,33 +158,30 @@ std::string JtagShiftedData::GetHexOrBinaryString( const std::vector<U8>& bits,
     return ret_val;
 }
 
-std::string JtagShiftedData::GetStringFromBitStates( const std::vector<U8>& bits, DisplayBase display_base, TdiTdoStringFormat format )
+std::string JtagShiftedData::GetStringFromBitStates( const JtagBitView& bits, DisplayBase display_base, TdiTdoStringFormat format )
 {
-    if( format == TdiTdoStringFormat::Ellipsis64 && bits.size() > 64 )
-    {
-        std::vector<U8> subset( bits.end() - 64, bits.end() );
-        return "..." + GetStringFromBitStates( subset, display_base, format );
-    }
+    const U64 bit_count = bits.GetBitCount();
 
-    if( format == TdiTdoStringFormat::Ellipsis256 && bits.size() > 256 )
-    {
-        std::vector<U8> subset( bits.end() - 256, bits.end() );
-        return "..." + GetStringFromBitStates( subset, display_base, format );
-    }
+    // only the tail is formatted, whatever the size of the payload
+    if( format == TdiTdoStringFormat::Ellipsis64 && bit_count > 64 )
+        return "..." + GetStringFromBitStates( bits.SubRange( bit_count - 64, 64 ), display_base, TdiTdoStringFormat::SingleString );
+
+    if( format == TdiTdoStringFormat::Ellipsis256 && bit_count > 256 )
+        return "..." + GetStringFromBitStates( bits.SubRange( bit_count - 256, 256 ), display_base, TdiTdoStringFormat::SingleString );
 
-    if( ( format == TdiTdoStringFormat::Break64 && bits.size() > 64 ) || ( format == TdiTdoStringFormat::Break256 && bits.size() > 256 ) )
+    if( ( format == TdiTdoStringFormat::Break64 && bit_count > 64 ) || ( format == TdiTdoStringFormat::Break256 && bit_count > 256 ) )
     {
         // lets break the result into N shorter strings of length range_size.
         // data is transmitted LSB first, as a signle, huge word. lets write out the data with the lower word first.
-        S32 range_size = ( format == TdiTdoStringFormat::Break64 ) ? 64 : 256;
+        U64 range_size = ( format == TdiTdoStringFormat::Break64 ) ? 64 : 256;
 
-        S32 range_end = bits.size();
+        U64 range_end = bit_count;
         std::string result = "";
         while( range_end > 0 )
         {
-            S32 range_start = std::max( range_end - range_size, 0 );
-            std::vector<U8> subset( bits.begin() + range_start, bits.begin() + range_end );
-            range_end -= range_size;
+            U64 range_start = ( range_end > range_size ) ? range_end - range_size : 0;
+            JtagBitView subset( bits.SubRange( range_start, range_end - range_start ) );
+            range_end = range_start;
 
             result += "[" + GetStringFromBitStates( subset, display_base, format ) + "]";
             if( range_end > 0 )
@@ -185,7 +193,7 @@ std::string JtagShiftedData::GetStringFromBitStates( const std::vector<U8>& bits
 
     std::string ret_val;
 
-    if( bits.size() > 64 )
+    if( bit_count > 64 )
     {
         if( display_base == Hexadecimal || display_base == Binary )
             ret_val = GetHexOrBinaryString( bits, display_base );
@@ -199,21 +207,51 @@ std::string JtagShiftedData::GetStringFromBitStates( const std::vector<U8>& bits
     else
     {
         // get the numerical value from the bits
-        std::vector<U8>::const_iterator bsi( bits.begin() );
-
-        U64 val;
-
-        // make a 64 bit value
-        for( val = 0; bsi != bits.end(); ++bsi )
-            val = ( val << 1 ) | ( *bsi == BIT_HIGH ? 1 : 0 );
+        U64 val = bits.GetValue( 0, bit_count );
 
         // make a string out of that value
         char number_str[ 128 ];
 
-        AnalyzerHelpers::GetNumberString( val, display_base, ( U32 )bits.size(), number_str, sizeof( number_str ) );
+        AnalyzerHelpers::GetNumberString( val, display_base, ( U32 )bit_count, number_str, sizeof( number_str ) );
 
         ret_val = number_str;
     }
 
     return ret_val;
 }
+
+std::string JtagShiftedData::GetTailString( const JtagBitView& bits, DisplayBase display_base, size_t max_length )
+{
+    const U64 bit_count = bits.GetBitCount();
+
+    if( display_base != Hexadecimal && display_base != Binary )
+    {
+        std::string ret_val = GetStringFromBitStates( bits, display_base, TdiTdoStringFormat::Ellipsis256 );
+        if( ret_val.length() > max_length )
+            ret_val = ret_val.substr( 0, max_length > 3 ? max_length - 3 : 0 ) + "...";
+        return ret_val;
+    }
+
+    // hex and binary have a digit for every 4 or 1 bits, so the length is known up front.
+    // The first 64 bit chunk is the partial one, just like in GetHexOrBinaryString()
+    const U64 bits_per_digit = ( display_base == Hexadecimal ) ? 4 : 1;
+    const U64 first_chunk_bits = ( bit_count % 64 == 0 ) ? 64 : bit_count % 64;
+    const U64 digit_count = ( bit_count == 0 ) ? 0 : ( first_chunk_bits + bits_per_digit - 1 ) / bits_per_digit + ( bit_count - first_chunk_bits ) / bits_per_digit;
+    const size_t prefix_length = 2; // 0x or 0b
+
+    if( prefix_length + digit_count <= max_length )
+        return GetStringFromBitStates( bits, display_base, TdiTdoStringFormat::SingleString );
+
+    // too narrow for the ellipsis, so show the least significant digits alone, e.g. "0x5A3"
+    if( max_length < 3 + prefix_length + 1 )
+    {
+        if( max_length <= prefix_length )
+            return "...";
+
+        const U64 tail_bits = ( max_length - prefix_length ) * bits_per_digit;
+        return GetStringFromBitStates( bits.SubRange( bit_count - tail_bits, tail_bits ), display_base, TdiTdoStringFormat::SingleString );
+    }
+
+    const U64 tail_bits = ( max_length - 3 - prefix_length ) * bits_per_digit;
+    return "..." + GetStringFromBitStates( bits.SubRange( bit_count - tail_bits, tail_bits ), display_base, TdiTdoStringFormat::SingleString );
+}
@@ -6,9 +6,42 @@
 
 #include <stdio.h>
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
 // these define the TAP controller states
 const int NUM_TAP_STATES = 16;
 
+// bitmask with a bit set for every TAP state
+const U16 ALL_TAP_STATES_MASK = 0xFFFF;
+
+// Frame::mFlags bit set on frames decoded before the TAP state was known
+const U8 JTAG_FLAG_STATE_UNCERTAIN = 0x01;
+
+// Frame::mFlags bit set on frames where TMS/TDI/TDO changed closer to a TCK rising edge than the setup/hold threshold
+const U8 JTAG_FLAG_MARGIN_VIOLATION = 0x02;
+
+// Frame::mType of a frame standing in for repeats of the scans before it,
+// with the repeat count in mData1 and the number of scans per repeat in mData2
+const U8 JTAG_REPEATED_SCANS_FRAME = NUM_TAP_STATES;
+
+// Frame::mType of a frame standing in for the clocks while the debug port was out of JTAG mode,
+// with the JtagDebugPortMode in mData1 and the number of clocks in mData2
+const U8 JTAG_SUSPENDED_FRAME = NUM_TAP_STATES + 1;
+
+// the frame index passed on for the frames the store filter drops
+const U64 JTAG_FRAME_NOT_STORED = ~0ULL;
+
+// the protocol of an ARM SWJ-DP, which switches with select sequences on TMS/SWDIO
+enum JtagDebugPortMode
+{
+    DebugPortJtag,
+    DebugPortSwd,
+    DebugPortDormant,
+};
+
 enum JtagTAPState
 {
     TestLogicReset, // the first two states
@@ -37,6 +70,9 @@ class JtagTAP_Controller
   private:
     JtagTAPState mCurrTAPState;
 
+    // one bit per TAP state the controller could actually be in. mCurrTAPState is always one of them.
+    U16 mCandidateStates;
+
   public:
     JtagTAP_Controller();
 
@@ -44,6 +80,15 @@ class JtagTAP_Controller
     void SetState( JtagTAPState newState )
     {
         mCurrTAPState = newState;
+        mCandidateStates = U16( 1 << newState );
+    }
+
+    // Starts from an unknown state. guessed_state is reported until the TMS history
+    // narrows the candidates down to a single state.
+    void SetStateUnknown( JtagTAPState guessed_state )
+    {
+        mCurrTAPState = guessed_state;
+        mCandidateStates = ALL_TAP_STATES_MASK;
     }
 
     // This function implements the TAP state machine transitions.
@@ -54,55 +99,287 @@ class JtagTAP_Controller
     {
         return mCurrTAPState;
     }
+
+    // true once only one candidate state is left
+    bool IsStateKnown() const
+    {
+        return ( mCandidateStates & ( mCandidateStates - 1 ) ) == 0;
+    }
+
+    U16 GetCandidateStates() const
+    {
+        return mCandidateStates;
+    }
 };
 
-// Contains data that is being shifted on TDI/TDO, and functions for converting that data to strings
-struct JtagShiftedData
+// Shifted bits packed 64 to a word, in the order they were shifted
+class JtagPackedBits
 {
-    enum class TdiTdoStringFormat
+  public:
+    JtagPackedBits() : mBitCount( 0 )
     {
-        SingleString,
-        Break64,
-        Ellipsis64,
-        Break256,
-        Ellipsis256
-    };
+    }
+
+    void PushBack( U8 bit_state )
+    {
+        if( ( mBitCount & 63 ) == 0 )
+            mWords.push_back( 0 );
+
+        if( bit_state == BIT_HIGH )
+            mWords.back() |= 1ULL << ( mBitCount & 63 );
+
+        ++mBitCount;
+    }
 
-    U64 mStartSampleIndex;
+    void Append( const JtagPackedBits& other )
+    {
+        for( U64 bit_index = 0; bit_index < other.mBitCount; ++bit_index )
+            PushBack( ( ( other.mWords[ bit_index >> 6 ] >> ( bit_index & 63 ) ) & 1 ) ? BIT_HIGH : BIT_LOW );
+    }
+
+    // bit_count bits starting at first_bit of the words, a word at a time
+    void AppendWords( const U64* words, U64 first_bit, U64 bit_count )
+    {
+        for( U64 bit_index = 0; bit_index < bit_count; )
+        {
+            const U64 count = std::min( bit_count - bit_index, U64( 64 ) );
+            const U64 source_bit = first_bit + bit_index;
+            const U64 source_offset = source_bit & 63;
 
-    std::vector<U8> mTdiBits;
-    std::vector<U8> mTdoBits;
+            U64 word = words[ source_bit >> 6 ] >> source_offset;
+            if( source_offset + count > 64 )
+                word |= words[ ( source_bit >> 6 ) + 1 ] << ( 64 - source_offset );
+            if( count < 64 )
+                word &= ( 1ULL << count ) - 1;
 
-    static std::string GetStringFromBitStates( const std::vector<U8>& bits, DisplayBase display_base, TdiTdoStringFormat format );
-    static std::string GetDecimalString( const std::vector<U8>& bits );
-    static std::string GetASCIIString( const std::vector<U8>& bits );
-    static std::string GetHexOrBinaryString( const std::vector<U8>& bits, DisplayBase display_base );
+            const U64 offset = mBitCount & 63;
+            if( offset == 0 )
+                mWords.push_back( word );
+            else
+            {
+                mWords.back() |= word << offset;
+                if( offset + count > 64 )
+                    mWords.push_back( word >> ( 64 - offset ) );
+            }
 
-    std::string GetTDIString( DisplayBase display_base, TdiTdoStringFormat format = TdiTdoStringFormat::SingleString ) const
+            mBitCount += count;
+            bit_index += count;
+        }
+    }
+
+    void Clear()
     {
-        return GetStringFromBitStates( mTdiBits, display_base, format );
+        mWords.clear();
+        mBitCount = 0;
     }
 
-    std::string GetTDOString( DisplayBase display_base, TdiTdoStringFormat format = TdiTdoStringFormat::SingleString ) const
+    void Reserve( U64 bit_count )
     {
-        return GetStringFromBitStates( mTdoBits, display_base, format );
+        mWords.reserve( size_t( ( bit_count + 63 ) / 64 ) );
     }
 
-    std::string GetTDILengthString( bool with_parentheses = true ) const
+    void Swap( JtagPackedBits& other )
     {
-        U64 bit_count = mTdiBits.size();
-        S8 bit_count_buffer[ 128 ];
-        if( with_parentheses )
-            sprintf( bit_count_buffer, "(%llu)", bit_count );
-        else
-            sprintf( bit_count_buffer, "%llu", bit_count );
-        std::string bit_count_string = bit_count_buffer;
-        return bit_count_string;
+        mWords.swap( other.mWords );
+        std::swap( mBitCount, other.mBitCount );
+    }
+
+    U64 GetBitCount() const
+    {
+        return mBitCount;
+    }
+
+    const U64* GetWords() const
+    {
+        return mWords.empty() ? NULL : &mWords[ 0 ];
+    }
+
+  protected:
+    std::vector<U64> mWords;
+    U64 mBitCount;
+};
+
+// Collects the bits of a shift in fixed size blocks, so however long a shift gets, the bits shifted so far
+// are never moved. Only the first block is kept from one shift to the next, so a single long shift
+// doesn't hold on to its memory for the rest of the capture.
+class JtagPackedBitsBuilder
+{
+  public:
+    JtagPackedBitsBuilder() : mBitCount( 0 ), mWord( NULL )
+    {
+    }
+
+    void PushBack( U8 bit_state )
+    {
+        if( ( mBitCount & 63 ) == 0 )
+            StartWord();
+
+        if( bit_state == BIT_HIGH )
+            *mWord |= 1ULL << ( mBitCount & 63 );
+
+        ++mBitCount;
+    }
+
+    U64 GetBitCount() const
+    {
+        return mBitCount;
     }
 
-    std::string GetTDOLengthString( bool with_parentheses = true ) const
+    // hands the bits over in a single allocation of their exact size, and starts over
+    void MoveTo( JtagPackedBits& bits )
+    {
+        bits.Clear();
+        bits.Reserve( mBitCount );
+
+        for( size_t block_idx = 0; block_idx * BLOCK_BITS < mBitCount; ++block_idx )
+            bits.AppendWords( mBlocks[ block_idx ].get(), 0, std::min( mBitCount - block_idx * BLOCK_BITS, U64( BLOCK_BITS ) ) );
+
+        Clear();
+    }
+
+    void Clear()
+    {
+        mBitCount = 0;
+
+        if( mBlocks.size() > 1 )
+            mBlocks.resize( 1 );
+    }
+
+  protected:
+    static const size_t BLOCK_WORDS = 1024;
+    static const U64 BLOCK_BITS = BLOCK_WORDS * 64;
+
+    void StartWord()
+    {
+        const size_t block_idx = size_t( mBitCount / BLOCK_BITS );
+        if( block_idx == mBlocks.size() )
+            mBlocks.emplace_back( new U64[ BLOCK_WORDS ] );
+
+        mWord = &mBlocks[ block_idx ][ size_t( mBitCount % BLOCK_BITS ) >> 6 ];
+        *mWord = 0;
+    }
+
+    std::vector<std::unique_ptr<U64[]>> mBlocks;
+    U64 mBitCount;
+    U64* mWord; // the word the next bit goes into
+};
+
+// Read-only view of shifted bits in display order, where bit 0 is the most significant bit.
+// The bit order is only applied here, the packed bits are never reordered.
+class JtagBitView
+{
+  public:
+    JtagBitView( const U64* words, U64 bit_count, bool lsb_first )
+        : mWords( words ), mFirstBit( 0 ), mBitCount( bit_count ), mLsbFirst( lsb_first )
+    {
+    }
+
+    JtagBitView( const JtagPackedBits& bits, bool lsb_first )
+        : mWords( bits.GetWords() ), mFirstBit( 0 ), mBitCount( bits.GetBitCount() ), mLsbFirst( lsb_first )
+    {
+    }
+
+    U64 GetBitCount() const
+    {
+        return mBitCount;
+    }
+
+    U8 GetBit( U64 display_index ) const
+    {
+        U64 bit_index = mLsbFirst ? mFirstBit + mBitCount - 1 - display_index : mFirstBit + display_index;
+        return ( mWords[ bit_index >> 6 ] >> ( bit_index & 63 ) ) & 1 ? BIT_HIGH : BIT_LOW;
+    }
+
+    // value of up to 64 bits starting at display_begin, read a word at a time from the packed bits
+    U64 GetValue( U64 display_begin, U64 count ) const
+    {
+        if( count == 0 )
+            return 0;
+
+        U64 bit_index = mLsbFirst ? mFirstBit + mBitCount - display_begin - count : mFirstBit + display_begin;
+        U64 word_index = bit_index >> 6;
+        U64 bit_offset = bit_index & 63;
+
+        U64 val = mWords[ word_index ] >> bit_offset;
+        if( bit_offset + count > 64 )
+            val |= mWords[ word_index + 1 ] << ( 64 - bit_offset );
+        if( count < 64 )
+            val &= ( 1ULL << count ) - 1;
+
+        // the first shifted bit is the least significant one, unless the bits came MSB first
+        if( !mLsbFirst )
+            val = ReverseBits( val ) >> ( 64 - count );
+
+        return val;
+    }
+
+    // the least significant 64 bits of the value
+    U64 GetTailValue() const
+    {
+        const U64 count = mBitCount < 64 ? mBitCount : 64;
+        return GetValue( mBitCount - count, count );
+    }
+
+    static U64 ReverseBits( U64 val )
+    {
+        val = ( ( val >> 1 ) & 0x5555555555555555ULL ) | ( ( val & 0x5555555555555555ULL ) << 1 );
+        val = ( ( val >> 2 ) & 0x3333333333333333ULL ) | ( ( val & 0x3333333333333333ULL ) << 2 );
+        val = ( ( val >> 4 ) & 0x0F0F0F0F0F0F0F0FULL ) | ( ( val & 0x0F0F0F0F0F0F0F0FULL ) << 4 );
+        val = ( ( val >> 8 ) & 0x00FF00FF00FF00FFULL ) | ( ( val & 0x00FF00FF00FF00FFULL ) << 8 );
+        val = ( ( val >> 16 ) & 0x0000FFFF0000FFFFULL ) | ( ( val & 0x0000FFFF0000FFFFULL ) << 16 );
+        return ( val >> 32 ) | ( val << 32 );
+    }
+
+    // appends the bits in the order they were shifted
+    void AppendTo( JtagPackedBits& bits ) const
+    {
+        bits.AppendWords( mWords, mFirstBit, mBitCount );
+    }
+
+    // count bits starting at display_begin, without copying anything
+    JtagBitView SubRange( U64 display_begin, U64 count ) const
+    {
+        JtagBitView sub_range( *this );
+        sub_range.mFirstBit = mLsbFirst ? mFirstBit + mBitCount - display_begin - count : mFirstBit + display_begin;
+        sub_range.mBitCount = count;
+        return sub_range;
+    }
+
+  protected:
+    const U64* mWords;
+    U64 mFirstBit;
+    U64 mBitCount;
+    bool mLsbFirst;
+};
+
+// Contains data that is being shifted on TDI/TDO, and functions for converting that data to strings
+struct JtagShiftedData
+{
+    enum class TdiTdoStringFormat
+    {
+        SingleString,
+        Break64,
+        Ellipsis64,
+        Break256,
+        Ellipsis256
+    };
+
+    // raw bits in shift order; the bit order setting is applied when the data is formatted
+    JtagPackedBits mTdiBits;
+    JtagPackedBits mTdoBits;
+
+    static std::string GetStringFromBitStates( const JtagBitView& bits, DisplayBase display_base, TdiTdoStringFormat format );
+    static std::string GetDecimalString( const JtagBitView& bits );
+    static std::string GetASCIIString( const JtagBitView& bits );
+    static std::string GetHexOrBinaryString( const JtagBitView& bits, DisplayBase display_base );
+
+    // Formats only the least significant digits that fit in max_length characters, e.g. "...0x5A3C",
+    // reading nothing but those bits. Widths too narrow for the ellipsis get the bare digits, e.g. "0x5A3".
+    // Decimal and ASCII digits depend on the whole value, so those fall back to cutting the Ellipsis256 string.
+    static std::string GetTailString( const JtagBitView& bits, DisplayBase display_base, size_t max_length );
+
+    static std::string GetLengthString( U64 bit_count, bool with_parentheses = true )
     {
-        U64 bit_count = mTdoBits.size();
         S8 bit_count_buffer[ 128 ];
         if( with_parentheses )
             sprintf( bit_count_buffer, "(%llu)", bit_count );
@@ -111,11 +388,6 @@ struct JtagShiftedData
         std::string bit_count_string = bit_count_buffer;
         return bit_count_string;
     }
-
-    bool operator<( const JtagShiftedData& lhs ) const
-    {
-        return mStartSampleIndex < lhs.mStartSampleIndex;
-    }
 };
 
 #endif // JTAG_TYPES_H
\ No newline at end of file